@@ -0,0 +1,353 @@
+#include "include/assembler.h"
+
+#include <elf.h>
+#include <format>
+
+static int num(reg r) { return static_cast<int>(r); }
+
+static bool fits8(int64_t v) { return v >= INT8_MIN && v <= INT8_MAX; }
+static bool fits32(int64_t v) { return v >= INT32_MIN && v <= INT32_MAX; }
+
+// condition codes of jcc/setcc, in the order of the opcode enum
+static const uint8_t ccodes[] = { 0x4,0x5,0xc,0xe,0xf,0xd };
+
+
+assembler::assembler(const emitter& e):emit(e) {}
+
+
+bool assembler::isLocal(int32_t sym)const {
+    return emit.name(sym).starts_with(".L");
+}
+
+
+void assembler::put32(uint32_t v) {
+    for(int i = 0; i < 4; i++) put(v >> (8 * i));
+}
+
+
+void assembler::put64(uint64_t v) {
+    for(int i = 0; i < 8; i++) put(v >> (8 * i));
+}
+
+
+/*
+ * [rex] opcode modrm [sib] [disp] [imm] with 'r' in the reg field (a register
+ * number or an opcode extension) and 'm' as the r/m operand.
+ */
+void assembler::rm(std::initializer_list<uint8_t> opc,int r,const operand& m,bool w,bool byteop,int immsize,int64_t imm) {
+    int b = m.base == reg::none || m.base == reg::rip ? 0 : num(m.base);
+    int x = m.isMem() && m.index != reg::none ? num(m.index) : 0;
+    uint8_t rex = 0x40 | (w << 3) | ((r >> 3) << 2) | ((x >> 3) << 1) | (b >> 3);
+    // without a rex prefix byte registers 4-7 mean %ah..%bh instead of %spl..%dil
+    bool lowbyte = byteop && ((r >= 4 && r < 8) || (m.isReg() && b >= 4 && b < 8));
+    if(rex != 0x40 || lowbyte) put(rex);
+    for(uint8_t o : opc) put(o);
+    modrm(r,m,immsize,imm);
+}
+
+
+// modrm [sib] [disp] [imm], the part every encoding shares
+void assembler::modrm(int r,const operand& m,int immsize,int64_t imm) {
+    int b = m.base == reg::none || m.base == reg::rip ? 0 : num(m.base);
+    int x = m.isMem() && m.index != reg::none ? num(m.index) : 0;
+    if(m.isReg()) {
+        put(0xc0 | ((r & 7) << 3) | (b & 7));
+    }else if(m.base == reg::rip) {
+        put(((r & 7) << 3) | 5);
+        auto &s = _sections[cur];
+        fixups.push_back({cur,s.size(),s.size() + 4 + immsize,m.sym,m.val,false});
+        put32(0);
+    }else {
+        bool sib = m.index != reg::none || (b & 7) == 4;
+        int mod = m.val == 0 && (b & 7) != 5 ? 0 : fits8(m.val) ? 1 : 2;
+        put((mod << 6) | ((r & 7) << 3) | (sib ? 4 : (b & 7)));
+        if(sib) {
+            int scale = m.scale == 8 ? 3 : m.scale == 4 ? 2 : m.scale == 2 ? 1 : 0;
+            int idx = m.index == reg::none ? 4 : (x & 7);
+            put((scale << 6) | (idx << 3) | (b & 7));
+        }
+        if(mod == 1) put(m.val);
+        else if(mod == 2) put32(m.val);
+    }
+    if(immsize == 1) put(imm);
+    else if(immsize == 4) put32(imm);
+}
+
+
+/*
+ * the SSE2 and AVX2 instructions, by mandatory prefix (none, 66, f3), opcode
+ * map (0f, 0f38, 0f3a) and opcode. stores of movdqu and moves out of an
+ * %xmm register take the opcode given here plus 0x10.
+ */
+struct simdform { uint8_t pp; uint8_t map; uint8_t op; };
+static const simdform simdforms[] = {
+    {1,1,0x6e},{1,1,0x6f},{2,1,0x6f},{1,1,0xfc},{1,1,0xd4},{1,1,0xf8},{1,1,0xfb},{1,1,0xef},
+    {1,1,0x60},{1,1,0x61},{1,1,0x62},{1,1,0x6c},{1,1,0x6d},
+    {1,1,0x6e},{1,1,0x6f},{2,1,0x6f},{1,1,0xfc},{1,1,0xd4},{1,1,0xf8},{1,1,0xfb},{1,1,0xef},{1,1,0x6d},
+    {1,2,0x78},{1,2,0x59},
+    {1,3,0x39},
+};
+
+
+void assembler::encodeSimd(const inst& in) {
+    bool vex = in.op >= opcode::vmovq;
+    simdform f = simdforms[static_cast<int>(in.op) - static_cast<int>(opcode::movq)];
+    bool movq = in.op == opcode::movq || in.op == opcode::vmovq;
+    // reg field and r/m operand: normally destination and source
+    operand r = in.b,m = in.a;
+    if((movq && in.a.isVec()) || (!movq && in.b.isMem()) || in.op == opcode::vextracti128) {
+        std::swap(r,m);
+        if(in.op != opcode::vextracti128) f.op += 0x10;
+    }
+    int immsize = in.op == opcode::vextracti128 ? 1 : 0;
+    if(!vex) {
+        put(f.pp == 1 ? 0x66 : 0xf3);
+        rm({0x0f,f.op},num(r.base),m,movq);
+        return;
+    }
+    int rr = num(r.base);
+    int b = m.base == reg::none || m.base == reg::rip ? 0 : num(m.base);
+    int x = m.isMem() && m.index != reg::none ? num(m.index) : 0;
+    int v = in.op >= opcode::vpaddb && in.op <= opcode::vpunpckhqdq ? num(in.b.base) : 0;
+    bool l = in.a.size == 32 || in.b.size == 32;
+    put(0xc4);
+    put((!(rr & 8) << 7) | (!(x & 8) << 6) | (!(b & 8) << 5) | f.map);
+    put((movq << 7) | ((~v & 15) << 3) | (l << 2) | f.pp);
+    put(f.op);
+    modrm(rr,m,immsize,1);
+}
+
+
+void assembler::encodeMov(const inst& in) {
+    const operand &src = in.a,&dst = in.b;
+    if(src.isImm()) {
+        if(dst.isReg() && !fits32(src.val)) {
+            // movabs
+            int r = num(dst.base);
+            put(0x48 | (r >> 3));
+            put(0xb8 + (r & 7));
+            put64(src.val);
+        }else if(dst.isReg() && src.val >= 0 && src.val <= UINT32_MAX) {
+            // a 32-bit move zero-extends into the full register
+            int r = num(dst.base);
+            if(r >= 8) put(0x41);
+            put(0xb8 + (r & 7));
+            put32(src.val);
+        }else {
+            rm({0xc7},0,dst,true,false,4,src.val);
+        }
+    }else if(src.isReg() && src.size == 1) {
+        rm({0x88},num(src.base),dst,false,true);
+    }else if(src.isReg()) {
+        rm({0x89},num(src.base),dst,true);
+    }else {
+        rm({0x8b},num(dst.base),src,true);
+    }
+}
+
+
+// add/sub/cmp: 'digit' selects the operation in the immediate forms
+void assembler::encodeAlu(const inst& in,uint8_t digit,uint8_t rm_r,uint8_t r_rm) {
+    const operand &src = in.a,&dst = in.b;
+    if(src.isImm()) {
+        if(fits8(src.val)) rm({0x83},digit,dst,true,false,1,src.val);
+        else rm({0x81},digit,dst,true,false,4,src.val);
+    }else if(src.isReg()) {
+        rm({rm_r},num(src.base),dst,true);
+    }else {
+        rm({r_rm},num(dst.base),src,true);
+    }
+}
+
+
+void assembler::encodeImul(const inst& in) {
+    const operand &src = in.a,&dst = in.b;
+    if(src.isImm()) {
+        if(fits8(src.val)) rm({0x6b},num(dst.base),dst,true,false,1,src.val);
+        else rm({0x69},num(dst.base),dst,true,false,4,src.val);
+    }else {
+        rm({0x0f,0xaf},num(dst.base),src,true);
+    }
+}
+
+
+void assembler::encodeBranch(std::initializer_list<uint8_t> opc,int32_t sym) {
+    for(uint8_t o : opc) put(o);
+    auto &s = _sections[cur];
+    fixups.push_back({cur,s.size(),s.size() + 4,sym,0,true});
+    put32(0);
+}
+
+
+// the string as the assembler's .string or .ascii would store it: escapes decoded, NUL appended or not
+void assembler::encodeString(std::string_view str,bool nul) {
+    for(size_t i = 0; i < str.size(); i++) {
+        char c = str[i];
+        if(c != '\\' || i + 1 == str.size()) {
+            put(c);
+            continue;
+        }
+        c = str[++i];
+        switch(c) {
+            case 'n': put('\n');break;
+            case 't': put('\t');break;
+            case 'r': put('\r');break;
+            case 'b': put('\b');break;
+            case 'f': put('\f');break;
+            case 'x': {
+                int v = 0;
+                while(i + 1 < str.size() && isxdigit(static_cast<unsigned char>(str[i + 1]))) {
+                    char h = str[++i];
+                    v = v * 16 + (isdigit(static_cast<unsigned char>(h)) ? h - '0' : (tolower(h) - 'a' + 10));
+                }
+                put(v);
+                break;
+            }
+            default:
+                if(c >= '0' && c <= '7') {
+                    int v = c - '0';
+                    for(int n = 0; n < 2 && i + 1 < str.size() && str[i + 1] >= '0' && str[i + 1] <= '7'; n++) {
+                        v = v * 8 + (str[++i] - '0');
+                    }
+                    put(v);
+                }else {
+                    put(c);
+                }
+        }
+    }
+    if(nul) put(0);
+}
+
+
+bool assembler::encode(const inst& in) {
+    switch(in.op) {
+        case opcode::label: {
+            if(static_cast<size_t>(in.a.sym) >= labels.size()) labels.resize(in.a.sym + 1);
+            label &l = labels[in.a.sym];
+            if(l.section >= 0) {
+                _error = std::format("symbol '{}' is already defined",emit.name(in.a.sym));
+                return false;
+            }
+            l.section = cur;
+            l.offset = _sections[cur].size();
+            break;
+        }
+        case opcode::globl:
+            if(static_cast<size_t>(in.a.sym) >= labels.size()) labels.resize(in.a.sym + 1);
+            labels[in.a.sym].global = true;
+            break;
+        case opcode::text:   cur = S_text;break;
+        case opcode::data:   cur = S_data;break;
+        case opcode::rodata: cur = S_rodata;break;
+        case opcode::strings: cur = S_strings;break;
+        case opcode::zero:   _sections[cur].resize(_sections[cur].size() + in.a.val);break;
+        case opcode::string: encodeString(emit.name(in.a.sym),true);break;
+        case opcode::ascii:  encodeString(emit.name(in.a.sym),false);break;
+        case opcode::byte:   put(in.a.val);break;
+        case opcode::quad:
+            if(in.a.kind == operand::Kind::O_sym) addresses.push_back({cur,_sections[cur].size(),in.a.sym,in.a.val});
+            put64(in.a.kind == operand::Kind::O_sym ? 0 : in.a.val);
+            break;
+
+        case opcode::mov:    encodeMov(in);break;
+        case opcode::movsbq: rm({0x0f,0xbe},num(in.b.base),in.a,true,in.a.isReg());break;
+        case opcode::movzbq: rm({0x0f,0xb6},num(in.b.base),in.a,true,in.a.isReg());break;
+        case opcode::lea:    rm({0x8d},num(in.b.base),in.a,true);break;
+        case opcode::add:    encodeAlu(in,0,0x01,0x03);break;
+        case opcode::sub:    encodeAlu(in,5,0x29,0x2b);break;
+        case opcode::cmp:    encodeAlu(in,7,0x39,0x3b);break;
+        case opcode::imul:   encodeImul(in);break;
+        case opcode::idiv:   rm({0xf7},7,in.a,true);break;
+        case opcode::neg:    rm({0xf7},3,in.a,true);break;
+        case opcode::cqo:    put(0x48);put(0x99);break;
+        case opcode::shl:    rm({0xc1},4,in.b,true,false,1,in.a.val);break;
+        case opcode::sar:    rm({0xc1},7,in.b,true,false,1,in.a.val);break;
+        case opcode::sete: case opcode::setne: case opcode::setl:
+        case opcode::setle: case opcode::setg: case opcode::setge:
+            rm({0x0f,static_cast<uint8_t>(0x90 | ccodes[static_cast<int>(in.op) - static_cast<int>(opcode::sete)])},0,in.a,false,true);
+            break;
+        case opcode::jmp:    encodeBranch({0xe9},in.a.sym);break;
+        case opcode::je: case opcode::jne: case opcode::jl:
+        case opcode::jle: case opcode::jg: case opcode::jge:
+            encodeBranch({0x0f,static_cast<uint8_t>(0x80 | ccodes[static_cast<int>(in.op) - static_cast<int>(opcode::je)])},in.a.sym);
+            break;
+        case opcode::call:   encodeBranch({0xe8},in.a.sym);break;
+        case opcode::ret:    put(0xc3);break;
+        case opcode::push:
+        case opcode::pop: {
+            int r = num(in.a.base);
+            if(r >= 8) put(0x41);
+            put((in.op == opcode::push ? 0x50 : 0x58) + (r & 7));
+            break;
+        }
+        case opcode::nop:    put(0x90);break;
+        case opcode::repmovsb: put(0xf3);put(0xa4);break;
+        case opcode::repstosb: put(0xf3);put(0xaa);break;
+        case opcode::vzeroupper: put(0xc5);put(0xf8);put(0x77);break;
+        default:             encodeSimd(in);break;
+    }
+    return true;
+}
+
+
+int32_t assembler::symbolIndex(int32_t sym) {
+    if(static_cast<size_t>(sym) >= symindex.size()) symindex.resize(sym + 1,-1);
+    if(symindex[sym] < 0) {
+        symindex[sym] = _symbols.size();
+        symbol s;
+        s.name = emit.name(sym);
+        if(static_cast<size_t>(sym) < labels.size()) {
+            s.section = labels[sym].section;
+            s.value = labels[sym].offset;
+            s.global = labels[sym].global || s.section < 0;
+        }else {
+            s.global = true;
+        }
+        _symbols.push_back(s);
+    }
+    return symindex[sym];
+}
+
+
+bool assembler::run() {
+    for(const inst& in : emit.insts()) {
+        if(!encode(in)) return false;
+    }
+    // every non-local label becomes a symbol, sized up to the next one
+    for(size_t sym = 0; sym < labels.size(); sym++) {
+        if(labels[sym].section >= 0 && !isLocal(sym)) symbolIndex(sym);
+    }
+    for(auto &s : _symbols) {
+        if(s.section < 0) continue;
+        uint64_t end = _sections[s.section].size();
+        for(auto &o : _symbols) {
+            if(o.section == s.section && o.value > s.value && o.value < end) end = o.value;
+        }
+        s.size = end - s.value;
+    }
+
+    for(const fixup& f : fixups) {
+        bool defined = static_cast<size_t>(f.sym) < labels.size() && labels[f.sym].section >= 0;
+        if(defined && labels[f.sym].section == f.section) {
+            int64_t rel = labels[f.sym].offset + f.disp - f.end;
+            auto &s = _sections[f.section];
+            for(int i = 0; i < 4; i++) s[f.offset + i] = static_cast<uint64_t>(rel) >> (8 * i);
+            continue;
+        }
+        if(isLocal(f.sym) && !defined) {
+            _error = std::format("undefined label '{}'",emit.name(f.sym));
+            return false;
+        }
+        uint32_t type = f.branch ? R_X86_64_PLT32 : R_X86_64_PC32;
+        int64_t addend = f.disp - static_cast<int64_t>(f.end - f.offset);
+        _relocs.push_back({f.section,f.offset,symbolIndex(f.sym),type,addend});
+    }
+    for(const address& a : addresses) {
+        if(isLocal(a.sym) && !(static_cast<size_t>(a.sym) < labels.size() && labels[a.sym].section >= 0)) {
+            _error = std::format("undefined label '{}'",emit.name(a.sym));
+            return false;
+        }
+        _relocs.push_back({a.section,a.offset,symbolIndex(a.sym),R_X86_64_64,a.addend});
+    }
+    return true;
+}
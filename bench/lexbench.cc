@@ -0,0 +1,58 @@
+#include "../include/lexer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+
+/*
+ * lexer throughput on synthetic sources of about 16MB each, reported as
+ * the best of several passes over the same text.
+ */
+
+static std::string program(size_t bytes,int namelen,int indent) {
+    std::mt19937 rng(1);
+    auto name = [&](char first) {
+        std::string s(1,first);
+        while(static_cast<int>(s.size()) < namelen) s.push_back("abcdefghijklmnopqrstuvwxyz_0123456789"[rng() % 37]);
+        return s;
+    };
+    std::string pad(indent,' ');
+    std::string src;
+    for(int f = 0; src.size() < bytes; f++) {
+        std::string a = name('a'),b = name('b'),i = name('i');
+        src += std::format("int {}{}(int {}, int *{}) {{\n",name('f'),f,a,b);
+        src += std::format("{}int {}; int t[16];\n",pad,i);
+        src += std::format("{}for({} = 0; {} < 16; {} = {} + 1) {{\n",pad,i,i,i,i);
+        src += std::format("{}{}t[{}] = {} * {} + 0x1f - *{};\n",pad,pad,i,a,i,b);
+        src += std::format("{}}}\n",pad);
+        src += std::format("{}if({} >= 100) return {}(\"{}\");\n",pad,a,name('p'),std::string(namelen * 2,'s'));
+        src += std::format("{}return t[3] / 2;\n}}\n",pad);
+    }
+    return src;
+}
+
+
+static void measure(const char *what,const std::string& src) {
+    double best = 1e30;
+    size_t tokens = 0;
+    for(int pass = 0; pass < 5; pass++) {
+        auto t0 = std::chrono::steady_clock::now();
+        lexer lex(src);
+        tokens = 0;
+        while(lex.newToken().type != tokenType::T_eof) tokens++;
+        std::chrono::duration<double> t = std::chrono::steady_clock::now() - t0;
+        best = std::min(best,t.count());
+    }
+    std::printf("%-28s %8.1f MB/s %8.1f Mtokens/s\n",what,src.size() / best / 1e6,tokens / best / 1e6);
+}
+
+
+int main() {
+    const size_t bytes = 16 << 20;
+    measure("short names",program(bytes,3,4));
+    measure("long names",program(bytes,24,4));
+    measure("deep indentation",program(bytes,6,40));
+    return 0;
+}
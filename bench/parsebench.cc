@@ -0,0 +1,69 @@
+#include "../include/parse.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+/*
+ * parser throughput on synthetic sources of about 8MB each, reported as
+ * the best of several passes. the lexer runs inside the parse, so its
+ * share is in the figures too; lexbench has it alone.
+ */
+
+static const char *binary[] = {"+","-","*","/","<","<=",">",">=","==","!="};
+
+static std::string expr(std::mt19937& rng,int depth) {
+    const char *vars[] = {"a","b","c","x","y","z"};
+    if(depth == 0 || rng() % 4 == 0) {
+        if(rng() % 3 == 0) return std::to_string(rng() % 100 + 1);
+        return vars[rng() % 6];
+    }
+    std::string lhs = expr(rng,depth - 1),rhs = expr(rng,depth - 1);
+    switch(rng() % 6) {
+        case 0: return std::format("({} {} {})",lhs,binary[rng() % 10],rhs);
+        case 1: return std::format("-{} {} {}",lhs,binary[rng() % 4],rhs);
+        default: return std::format("{} {} {}",lhs,binary[rng() % 10],rhs);
+    }
+}
+
+
+// functions of long expression statements, or of many short statements
+static std::string program(size_t bytes,int depth,int stmts) {
+    std::mt19937 rng(1);
+    std::string src;
+    for(int f = 0; src.size() < bytes; f++) {
+        src += std::format("int f{}(int a, int b, int c) {{\n    int x; int y; int z;\n    x = a; y = b; z = c;\n",f);
+        for(int s = 0; s < stmts; s++) {
+            const char *dst[] = {"x","y","z"};
+            if(s % 4 == 3) src += std::format("    if({}) {} = {};\n",expr(rng,depth),dst[rng() % 3],expr(rng,depth));
+            else src += std::format("    {} = {};\n",dst[rng() % 3],expr(rng,depth));
+        }
+        src += std::format("    return {};\n}}\n",expr(rng,depth));
+    }
+    src += "int main() { return 0; }\n";
+    return src;
+}
+
+
+static void measure(const char *what,const std::string& src) {
+    double best = 1e30;
+    for(int pass = 0; pass < 5; pass++) {
+        auto t0 = std::chrono::steady_clock::now();
+        {
+            Parser p(src.c_str());
+            p.start();
+        }
+        std::chrono::duration<double> t = std::chrono::steady_clock::now() - t0;
+        best = std::min(best,t.count());
+    }
+    std::printf("%-28s %8.1f MB/s\n",what,src.size() / best / 1e6);
+}
+
+
+int main() {
+    const size_t bytes = 8 << 20;
+    measure("deep expressions",program(bytes,6,8));
+    measure("shallow expressions",program(bytes,2,24));
+    return 0;
+}
@@ -1,310 +1,630 @@
 #include "include/codegenerator.h"
 
+#include <algorithm>
+#include <format>
 
-int level() {
-    static int level = 0;
-    return level++;
+static const operand rax = operand::r(reg::rax);
+static const operand r11 = operand::r(reg::r11);
+
+
+static bool fitsImm32(int64_t v) {
+    return v >= INT32_MIN && v <= INT32_MAX;
 }
 
-void codegenerator::push(std::string_view reg) {
-    std::cout << "  push %" << reg << "\n";
+
+// the condition that holds when the comparison does not
+static irOp inverted(irOp cc) {
+    static const irOp inv[] = { irOp::ge,irOp::gt,irOp::le,irOp::lt,irOp::ne,irOp::eq };
+    return inv[static_cast<int>(cc) - static_cast<int>(irOp::lt)];
 }
 
-void codegenerator::pop(std::string_view reg) {
-    std::cout << "  pop %" << reg << "\n";
+
+static opcode jcc(irOp cc) {
+    static const opcode j[] = { opcode::jl,opcode::jle,opcode::jg,opcode::jge,opcode::je,opcode::jne };
+    return j[static_cast<int>(cc) - static_cast<int>(irOp::lt)];
 }
 
-void gen_offset(visitor& vis,arrayVisit &v) {
-    size_t size = v.typeSize();
-    std::cout << std::format("  mov ${},%rax\n  push %rax\n",size);
-    auto idx = v.get_idx();
-    idx->accept(vis);
-    std::cout << "  pop %rdi\n  imul %rdi,%rax\n  push %rax\n";
+
+// the operand holding an IR value: its register, spill slot or immediate
+operand codegenerator::val(const irVal& v) {
+    switch(v.kind) {
+        case irVal::Kind::V_reg: return loc(v.v);
+        case irVal::Kind::V_imm: {
+            if(fitsImm32(v.v)) return operand::imm(v.v);
+            emit.emit(opcode::mov,operand::imm(v.v),r11);
+            return r11;
+        }
+        default: {
+            emit.emit(opcode::lea,mem(v),r11);
+            return r11;
+        }
+    }
 }
 
-void codegenerator::visit(numericNode& node) {
-    std::cout << std::format("  mov ${},%rax\n",node.Value());
+
+// the first of two operands, out of %r11 before the second may need it
+operand codegenerator::first(const irVal& v) {
+    operand o = val(v);
+    if(!o.isReg(reg::r11)) return o;
+    mov(o,rax);
+    return rax;
 }
 
-void codegenerator::visit(identNode& node) {
-    gen_addr(node);
-    load(node);
+
+// where a vreg lives, with its spill slot addressed from the frame
+operand codegenerator::loc(int vreg) {
+    operand o = ra->loc(vreg);
+    return o.isMem() ? frame(o.val) : o;
 }
 
-void codegenerator::visit(stringNode& node) {
-    gen_addr(node);
+
+/*
+ * a slot at 'off' from where %rbp would point. without a frame pointer
+ * %rsp is 'adjust' below the return address, so the same slot is at
+ * adjust - 8 + off from %rsp.
+ */
+operand codegenerator::frame(int64_t off) {
+    if(!omitFramePointer) return operand::mem(reg::rbp,off);
+    return operand::mem(reg::rsp,adjust - 8 + off);
 }
 
 
-void codegenerator::visit(prefixNode& node) {
-    if(node.equal(Node::Kind::N_addr)) {
-        gen_addr(*node.getNode());
-    }else if(node.equal(Node::Kind::N_deref)) {
-        node.getNode()->accept(*this);
-        std::cout << "  mov (%rax),%rax\n";
-    }else {
-        node.getNode()->accept(*this);
-        std::cout << std::format("  neg %rax\n");
+// the memory operand a load or store goes through
+operand codegenerator::mem(const irVal& addr) {
+    switch(addr.kind) {
+        case irVal::Kind::V_local:  return frame(addr.v);
+        case irVal::Kind::V_global: return operand::rip(emit.intern(mod->symName(addr.v)));
+        default: {
+            operand a = val(addr);
+            if(a.isReg()) return operand::mem(a.base);
+            emit.emit(opcode::mov,a,r11);
+            return operand::mem(reg::r11);
+        }
     }
 }
 
 
-void codegenerator::visit(funcallNode& node) {
-    std::array<const char *,6> regs{ "%rdi","%rsi","%rdx","%rcx","%r8","%r9" };
-    int nargs = 0;
-    auto &args = node.getArgs();
-    for(auto &arg : args) {
-        arg->accept(*this);
-        std::cout << "  push %rax\n";
-        nargs++;
-    }
-    for(int i = nargs-1; i >= 0; i--) {
-        std::cout << std::format("  pop {}\n",regs[i]);
+// the register an instruction computes its result in
+operand codegenerator::target(int dst) {
+    operand d = loc(dst);
+    return d.isReg() ? d : rax;
+}
+
+
+void codegenerator::mov(const operand& src,const operand& dst) {
+    if(src == dst) return;
+    if(src.isMem() && dst.isMem()) {
+        emit.emit(opcode::mov,src,rax);
+        emit.emit(opcode::mov,rax,dst);
+        return;
     }
-    std::cout << std::format("  call {}\n",node.getName());
+    emit.emit(opcode::mov,src,dst);
+}
+
+
+void codegenerator::writeBack(const operand& r,int dst) {
+    mov(r,loc(dst));
+}
+
+
+int32_t codegenerator::blockLabel(size_t idx) {
+    return emit.intern(std::format(".L.{}.{}",func->name,idx));
 }
 
 
-void codegenerator::gen_addr(Node& node) {
-    if(node.equal(Node::Kind::N_identifier)) {
-        auto ident = dynamic_cast<identNode&>(node);
-        if(ident.isGlobal())  
-            std::cout << std::format("  lea {}(%rip),%rax\n",ident.getName());
-        else
-            std::cout << std::format("  lea {}(%rbp),%rax\n",ident.getOffset());
+void codegenerator::genBinary(const irInst& in) {
+    static const opcode ops[] = { opcode::nop,opcode::add,opcode::sub,opcode::imul,opcode::nop,opcode::shl,opcode::sar };
+    opcode op = ops[static_cast<int>(in.op)];
+    operand a = first(in.a);
+    operand b = val(in.b);
+    operand r = target(in.dst);
+    if(r == b && r != a) {
+        if(in.op == irOp::sub) r = r11;
+        else std::swap(a,b);
     }
-    else if(node.equal(Node::Kind::N_arrayvisit)) {
-        auto arr = dynamic_cast<arrayVisit&>(node);
-        gen_offset(*this,arr);
-        if(arr.isGlobal()) {
-            std::cout << std::format("  lea {}(%rip),%rax\n",arr.getName());
-        }else {
-            std::cout << std::format("  lea {}(%rbp),%rax\n",arr.getOffset());
-        }
-        std::cout << "  pop %rdi\n  add %rdi,%rax\n";
+    mov(a,r);
+    emit.emit(op,b,r);
+    writeBack(r,in.dst);
+}
+
+
+void codegenerator::genDiv(const irInst& in) {
+    mov(val(in.a),rax);
+    operand b = val(in.b);
+    if(b.isImm() || b.isReg(reg::rdx)) {
+        mov(b,r11);
+        b = r11;
     }
-    else if(node.equal(Node::Kind::N_deref)){
-        auto prefix = dynamic_cast<prefixNode&>(node);
-        prefix.getNode()->accept(*this);
+    emit.emit(opcode::cqo);
+    emit.emit(opcode::idiv,b);
+    writeBack(rax,in.dst);
+}
+
+
+void codegenerator::genCompare(const irInst& in) {
+    static const opcode setcc[] = { opcode::setl,opcode::setle,opcode::setg,opcode::setge,opcode::sete,opcode::setne };
+    operand a = val(in.a);
+    if(a.isImm() || a.isReg(reg::r11)) {
+        mov(a,rax);
+        a = rax;
     }
-    else if(node.equal(Node::Kind::N_string)) {
-        auto str = dynamic_cast<stringNode&>(node);
-        std::cout << std::format("  lea .str.{}(%rip),%rax\n",str.get_label());
-    }else {
-        exit(-1);
+    operand b = val(in.b);
+    if(a.isMem() && b.isMem()) {
+        mov(a,rax);
+        a = rax;
     }
+    emit.emit(opcode::cmp,b,a);
+    emit.emit(setcc[static_cast<int>(in.op) - static_cast<int>(irOp::lt)],operand::r(reg::rax,1));
+    operand r = target(in.dst);
+    emit.emit(opcode::movzbq,operand::r(reg::rax,1),r);
+    writeBack(r,in.dst);
 }
 
 
-void codegenerator::store(const Node &node) {
-    pop("rdi");
-    if(node.getType()->getSize() == 1) {
-        std::cout << "  mov %al,(%rdi)\n";
-    }else {
-        std::cout << "  mov %rax,(%rdi)\n";
-    }
+void codegenerator::genLoad(const irInst& in) {
+    operand src = mem(in.a);
+    operand r = target(in.dst);
+    emit.emit(in.size == 1 ? opcode::movsbq : opcode::mov,src,r);
+    writeBack(r,in.dst);
 }
 
-void codegenerator::load(const Node& node) {
-    if(!Type::isArray(node.getType())){
-        if(node.getType()->getSize() == 1)
-            std::cout << "  movsbq (%rax),%rax\n";
-        else 
-            std::cout << "  mov (%rax),%rax\n";
+
+void codegenerator::genStore(const irInst& in) {
+    operand v = val(in.b);
+    if(v.isMem() || v.isReg(reg::r11) || (v.isImm() && in.size == 1)) {
+        mov(v,rax);
+        v = rax;
     }
+    operand dst = mem(in.a);
+    if(in.size == 1) v.size = 1;
+    emit.emit(opcode::mov,v,dst);
 }
 
 
-void codegenerator::visit(binaryNode& node) {
-    tokenType op = node.getOp();
-    auto lhs = node.getLhs();
-    auto rhs = node.getRhs();
-    if(op == tokenType::T_assign) {
-        if(rhs != nullptr) {
-            gen_addr(*lhs);
-            push("rax");
-            rhs->accept(*this);
-            store(*lhs);
-        }
+/*
+ * a block move. short ones go a register at a time, all of the same width,
+ * the last overlapping the one before where that width does not divide the
+ * length; long ones are left to the string instructions.
+ */
+void codegenerator::genBlock(const irInst& in) {
+    bool zero = in.op == irOp::blkzero;
+    int64_t n = in.args[0].v;
+    operand dst = mem(in.a);
+    if(n >= regalloc::stringBytes) {
+        emit.emit(opcode::lea,dst,operand::r(reg::rdi));
+        if(zero) emit.emit(opcode::mov,operand::imm(0),rax);
+        else emit.emit(opcode::lea,mem(in.b),operand::r(reg::rsi));
+        emit.emit(opcode::mov,operand::imm(n),operand::r(reg::rcx));
+        emit.emit(zero ? opcode::repstosb : opcode::repmovsb);
         return;
     }
-    rhs->accept(*this);
-    push("rax");
-    lhs->accept(*this);
-    pop("rdi");
-    switch(op) {
-        case tokenType::T_plus: {
-            std::cout << std::format("  add %rdi,%rax\n");break;
+    bool avx = func->vectorWidth == 32;
+    int w = avx && n >= 32 ? 32 : n >= 16 ? 16 : n >= 8 ? 8 : 1;
+    operand src = zero ? operand{} : mem(in.b),x = operand::vec(15,w);
+    if(zero && w >= 16) emit.emit(avx ? opcode::vpxor : opcode::pxor,x,x);
+    else if(zero && w == 1) emit.emit(opcode::mov,operand::imm(0),rax);
+    auto at = [](operand m,int64_t k) {
+        m.val += k;
+        return m;
+    };
+    for(int64_t k = 0; k < n; k += w) {
+        if(k + w > n) k = n - w;
+        if(w >= 16) {
+            if(!zero) emit.emit(avx ? opcode::vmovdqu : opcode::movdqu,at(src,k),x);
+            emit.emit(avx ? opcode::vmovdqu : opcode::movdqu,x,at(dst,k));
+        }else if(w == 8) {
+            if(zero) {
+                emit.emit(opcode::mov,operand::imm(0),at(dst,k));
+                continue;
+            }
+            emit.emit(opcode::mov,at(src,k),rax);
+            emit.emit(opcode::mov,rax,at(dst,k));
+        }else {
+            if(!zero) emit.emit(opcode::movsbq,at(src,k),rax);
+            emit.emit(opcode::mov,operand::r(reg::rax,1),at(dst,k));
         }
-        case tokenType::T_minus: {
-            std::cout << std::format("  sub %rdi,%rax\n");break;
+    }
+}
+
+
+// a vector register at the function's width
+operand codegenerator::vec(const irVal& v,int width) {
+    return operand::vec(v.v,width ? width : func->vectorWidth);
+}
+
+
+/*
+ * 16-byte vectors take SSE2, 32-byte ones AVX2 throughout, so the code
+ * never mixes the two encodings. %xmm15 is the scratch register.
+ */
+void codegenerator::genVector(const irInst& in) {
+    bool avx = func->vectorWidth == 32;
+    bool q = in.size == 8;
+    switch(in.op) {
+        case irOp::vsplat: {
+            operand x = vec(in.a,16),v = val(in.b);
+            if(v.isImm() && v.val == 0) {
+                emit.emit(avx ? opcode::vpxor : opcode::pxor,vec(in.a),vec(in.a));
+                break;
+            }
+            if(!v.isReg()) {
+                mov(v,r11);
+                v = r11;
+            }
+            emit.emit(avx ? opcode::vmovq : opcode::movq,v,x);
+            if(avx) {
+                emit.emit(q ? opcode::vpbroadcastq : opcode::vpbroadcastb,x,vec(in.a));
+            }else {
+                // doubling the lanes up to the full register
+                for(opcode op : { opcode::punpcklbw,opcode::punpcklwd,opcode::punpckldq,opcode::punpcklqdq }) {
+                    if(q && op != opcode::punpcklqdq) continue;
+                    emit.emit(op,x,x);
+                }
+            }
+            break;
         }
-        case tokenType::T_star: {
-            std::cout << std::format("  imul %rdi,%rax\n");break;
+        case irOp::vmov:
+            emit.emit(avx ? opcode::vmovdqa : opcode::movdqa,vec(in.b),vec(in.a));
+            break;
+        case irOp::vload:
+            emit.emit(avx ? opcode::vmovdqu : opcode::movdqu,mem(in.b),vec(in.a));
+            break;
+        case irOp::vstore: {
+            operand dst = mem(in.a);
+            emit.emit(avx ? opcode::vmovdqu : opcode::movdqu,vec(in.b),dst);
+            break;
         }
-        case tokenType::T_div: {
-            std::cout << std::format("  cqo\n  idiv %rdi\n");break;
+        case irOp::vadd:
+            if(avx) emit.emit(q ? opcode::vpaddq : opcode::vpaddb,vec(in.b),vec(in.a));
+            else emit.emit(q ? opcode::paddq : opcode::paddb,vec(in.b),vec(in.a));
+            break;
+        case irOp::vsub:
+            if(avx) emit.emit(q ? opcode::vpsubq : opcode::vpsubb,vec(in.b),vec(in.a));
+            else emit.emit(q ? opcode::psubq : opcode::psubb,vec(in.b),vec(in.a));
+            break;
+        case irOp::vsum: {
+            operand x = vec(in.a,16),t = operand::vec(15,16);
+            if(avx) {
+                emit.emit(opcode::vextracti128,vec(in.a),t);
+                emit.emit(opcode::vpaddq,t,x);
+            }
+            emit.emit(avx ? opcode::vmovdqa : opcode::movdqa,x,t);
+            emit.emit(avx ? opcode::vpunpckhqdq : opcode::punpckhqdq,t,t);
+            emit.emit(avx ? opcode::vpaddq : opcode::paddq,t,x);
+            operand r = target(in.dst);
+            emit.emit(avx ? opcode::vmovq : opcode::movq,x,r);
+            writeBack(r,in.dst);
+            break;
         }
-        case tokenType::T_lt:
-        case tokenType::T_le:
-        case tokenType::T_gt:
-        case tokenType::T_ge:
-        case tokenType::T_eq:
-        case tokenType::T_neq:
-         std::cout << std::format("  cmp %rdi,%rax\n");
-         if(op == tokenType::T_lt)
-             std::cout << std::format("  setl %al\n");
-         else if(op == tokenType::T_le)
-             std::cout << std::format("  setle %al\n");
-         else if(op == tokenType::T_gt)
-             std::cout << std::format("  setg %al\n");
-         else if(op == tokenType::T_ge)
-             std::cout << std::format("  setge %al\n");
-         else if(op == tokenType::T_eq)
-             std::cout << std::format("  sete %al\n");
-         else if(op == tokenType::T_neq)
-             std::cout << std::format("  setne %al\n");
-         std::cout << std::format("  movzb %al,%rax\n");
-        default: return;
+        default:break;
     }
 }
 
-void codegenerator::visit(whileStmt& S) {
-    std::string label = std::format(".while.{}", level());
-    std::string end_label = ".while.end";
-    std::cout << std::format("{}:\n",label);
-    S.compileCond(*this);
-    std::cout << std::format("  cmp $0,%rax\n  je {}\n",end_label);
-    S.compileBody(*this);
-    std::cout << std::format("  jmp {}\n{}:\n",label,end_label);
+
+/*
+ * moving the arguments into their registers is a parallel copy: a register
+ * may only be overwritten once no pending move still reads it, and a cycle
+ * is broken by parking one register in %r11. constants and addresses read
+ * no register, so they go last, each straight into its own register.
+ */
+void codegenerator::moveArgs(const irInst& in) {
+    struct move { operand src; reg dst; };
+    std::vector<move> moves;
+    for(size_t i = 0; i < in.args.size(); i++) {
+        if(!in.args[i].isReg()) continue;
+        operand src = loc(in.args[i].v);
+        if(!src.isReg(regalloc::argregs[i])) moves.push_back({src,regalloc::argregs[i]});
+    }
+    while(!moves.empty()) {
+        bool progress = false;
+        for(size_t i = 0; i < moves.size(); i++) {
+            reg d = moves[i].dst;
+            bool read = false;
+            for(size_t j = 0; j < moves.size(); j++) {
+                if(j != i && moves[j].src.isReg(d)) read = true;
+            }
+            if(!read) {
+                mov(moves[i].src,operand::r(d));
+                moves.erase(moves.begin() + i);
+                progress = true;
+                break;
+            }
+        }
+        if(!progress) {
+            reg d = moves[0].dst;
+            mov(operand::r(d),r11);
+            for(auto &m : moves) {
+                if(m.src.isReg(d)) m.src = r11;
+            }
+        }
+    }
+    for(size_t i = 0; i < in.args.size(); i++) {
+        if(!in.args[i].isReg()) mov(val(in.args[i]),operand::r(regalloc::argregs[i]));
+    }
 }
 
-void codegenerator::visit(forStmt &S) {
-    S.compileInit(*this);
-    std::string label = std::format(".for.{}",level());
-    std::string end_label = ".for.end";
-    std::cout << std::format("{}:\n",label);
-    if(S.compileCond(*this))
-        std::cout << std::format("  cmp $0,%rax\n  je {}\n",end_label);
-    S.compileBody(*this);
-    S.compileInc(*this);
-    std::cout << std::format("  jmp {}\n{}:\n",label,end_label);
+
+void codegenerator::genCall(const irInst& in) {
+    moveArgs(in);
+    // the callee may use SSE without paying for our dirty upper halves
+    if(func->vectorWidth == 32) emit.emit(opcode::vzeroupper);
+    emit.emit(opcode::call,operand::symbol(emit.intern(mod->symName(in.sym))));
+    writeBack(rax,in.dst);
 }
 
 
-void codegenerator::visit(ifStmt& S) {
-    int l = level();
-    auto &cond = S.getCond();
-    auto &then = S.getThen();
-    auto &elseStmt = S.getElse();
-    cond->accept(*this);
-    std::cout << "  cmp $0,%rax\n";
-    std::string label = elseStmt == nullptr ? std::format(".L.end.{}",l) : std::format(".L.else.{}",l);
-    std::cout << std::format("  je {}\n",label);
-    then->accept(*this);
-    if(elseStmt != nullptr) {
-        std::cout << std::format("  jmp .L.end.{}\n",l);
-        std::cout << std::format(".L.else.{}:\n",l);
-        elseStmt->accept(*this);
-    }
-    std::cout << std::format(".L.end.{}:\n",l);
+// the callee returns straight to our caller: the frame goes first, then jump
+void codegenerator::genTailCall(const irInst& in) {
+    moveArgs(in);
+    epilogue();
+    emit.emit(opcode::jmp,operand::symbol(emit.intern(mod->symName(in.sym))));
 }
 
 
-void codegenerator::visit(retStmt& S) {
-    S.compileStmt(*this);
-    std::cout << std::format("  jmp .L.{}.ret\n",retStmt::getName());
+void codegenerator::gen(const irInst& in) {
+    switch(in.op) {
+        case irOp::copy:
+            mov(val(in.a),target(in.dst));
+            writeBack(target(in.dst),in.dst);
+            break;
+        case irOp::add:
+        case irOp::sub:
+        case irOp::mul:
+        case irOp::shl:
+        case irOp::sar:
+            genBinary(in);
+            break;
+        case irOp::div:
+            genDiv(in);
+            break;
+        case irOp::neg: {
+            operand r = target(in.dst);
+            mov(val(in.a),r);
+            emit.emit(opcode::neg,r);
+            writeBack(r,in.dst);
+            break;
+        }
+        case irOp::lt:
+        case irOp::le:
+        case irOp::gt:
+        case irOp::ge:
+        case irOp::eq:
+        case irOp::ne:
+            genCompare(in);
+            break;
+        case irOp::addr: {
+            operand r = target(in.dst);
+            emit.emit(opcode::lea,mem(in.a),r);
+            writeBack(r,in.dst);
+            break;
+        }
+        case irOp::load:
+            genLoad(in);
+            break;
+        case irOp::store:
+            genStore(in);
+            break;
+        case irOp::blkcopy:
+        case irOp::blkzero:
+            genBlock(in);
+            break;
+        case irOp::call:
+            genCall(in);
+            break;
+        case irOp::param:
+            mov(operand::r(regalloc::argregs[in.a.v]),loc(in.dst));
+            break;
+        case irOp::ret:
+            if(!in.a.isNone()) mov(val(in.a),rax);
+            break;
+        default:
+            if(in.isVector()) genVector(in);
+            break;
+    }
 }
 
-void codegenerator::visit(exprStmt& S) {
-    S.getNode()->accept(*this);
+
+void codegenerator::genBranch(const irBlock& b,size_t idx) {
+    const irInst& term = b.terminator();
+    size_t next = idx + 1;
+    if(term.op == irOp::ret) {
+        if(next != func->blocks.size())
+            emit.emit(opcode::jmp,operand::symbol(retLabel));
+        return;
+    }
+    if(term.op == irOp::jmp) {
+        if(static_cast<size_t>(b.succs[0]) != next)
+            emit.emit(opcode::jmp,operand::symbol(blockLabel(b.succs[0])));
+        return;
+    }
+    int then = b.succs[0],other = b.succs[1];
+    irOp cc = term.cond;
+    if(term.a.isImm() && term.b.isImm()) {
+        int taken = irCompare(cc,term.a.v,term.b.v) ? then : other;
+        if(static_cast<size_t>(taken) != next)
+            emit.emit(opcode::jmp,operand::symbol(blockLabel(taken)));
+        return;
+    }
+    operand x = first(term.a);
+    operand y = val(term.b);
+    if(x.isImm()) {
+        std::swap(x,y);
+        cc = irSwapped(cc);
+    }
+    if(x.isMem() && y.isMem()) {
+        mov(x,r11);
+        x = r11;
+    }
+    emit.emit(opcode::cmp,y,x);
+    // fall through into whichever successor comes next
+    if(static_cast<size_t>(other) == next) {
+        emit.emit(jcc(cc),operand::symbol(blockLabel(then)));
+    }else {
+        emit.emit(jcc(inverted(cc)),operand::symbol(blockLabel(other)));
+        if(static_cast<size_t>(then) != next)
+            emit.emit(opcode::jmp,operand::symbol(blockLabel(then)));
+    }
 }
 
 
-void codegenerator::visit(arraydef& def) {
-    int offset = def.getOffset();
-    int size = def.elemSize();
-    const auto &init_lst = def.get_init_lst();
-    for(const auto& init : init_lst) {
-        init->accept(*this);
-        std::cout << std::format("  mov %rax,{}(%rbp)\n",offset);
-        offset += size;
+void codegenerator::gen(const irBlock& b,size_t idx) {
+    emit.emit(opcode::label,operand::symbol(blockLabel(idx)));
+    for(size_t i = 0; i < b.insts.size(); i++) {
+        if(tailCalls && b.isTailCall(i)) {
+            genTailCall(b.insts[i]);
+            return;
+        }
+        gen(b.insts[i]);
     }
+    genBranch(b,idx);
 }
 
 
-void codegenerator::visit(arrayVisit& v) {
-    if(v.isArray()) {
-        gen_addr(v);
-        load(v);
+// callee-saved registers back, frame released; %rsp is where it was on entry
+void codegenerator::epilogue() {
+    if(func->vectorWidth == 32) emit.emit(opcode::vzeroupper);
+    auto &saved = ra->calleeSaved();
+    for(size_t i = 0; i < saved.size(); i++) {
+        emit.emit(opcode::mov,frame(ra->saveOffset(i)),operand::r(saved[i]));
     }
-    else {
-        gen_offset(*this,v);
-        if(v.isGlobal()) {
-            std::cout << std::format("  lea {}(%rip),%rax\n",v.getName());
-        }else {
-            std::cout << std::format("  lea {}(%rbp),%rax\n",v.getOffset());
-        }
-        std::cout << "  mov (%rax),%rax\n  pop %rdi\n  add %rdi,%rax\n";
-        if(v.getType()->getSize() == 1)
-            std::cout << "  movsbq (%rax),%rax\n";
-        else 
-            std::cout << "  mov (%rax),%rax\n";
+    if(omitFramePointer) {
+        if(adjust) emit.emit(opcode::add,operand::imm(adjust),operand::r(reg::rsp));
+    }else {
+        emit.emit(opcode::mov,operand::r(reg::rbp),operand::r(reg::rsp));
+        emit.emit(opcode::pop,operand::r(reg::rbp));
     }
 }
 
 
-void codegenerator::visit(vardef& vars) {
-    auto &decls = vars.getDeclas();
-    if(vars.isGlobal()) {
-        for(auto &var : decls) {
-            if(var->equal(Node::Kind::N_string)) {
-                auto str = dynamic_cast<stringNode*>(var.get());
-                std::cout << std::format("  .globl .str.{}\n  .data\n.str.{}:\n",str->get_label(),str->get_label());
-                std::cout << std::format("  .string \"{}\"\n",str->strView());
-            } else if(var->equal(Node::Kind::N_identifier) || var->equal(Node::Kind::N_arraydef)) {
-                std::cout << std::format("  .globl {}\n  .data\n{}:\n",var->strView(),var->strView());
-                std::cout << std::format("  .zero {}\n",var->typeSize());
-            } else {
-                return;
+void codegenerator::gen(const irFunc& f) {
+    func = &f;
+    ra = std::make_unique<regalloc>(f);
+    // with a pointer into the frame around, the frame has to outlive every call
+    tailCalls = !f.addressesFrame();
+    retLabel = emit.intern(std::format(".L.{}.ret",f.name));
+
+    emit.globl(f.name);
+    emit.emit(opcode::text);
+    emit.label(f.name);
+    if(omitFramePointer) {
+        /*
+         * a leaf whose frame fits in the red zone below %rsp needs no
+         * adjustment at all; otherwise keep %rsp 16-byte aligned at calls.
+         */
+        bool leaf = true;
+        for(auto &b : f.blocks) {
+            for(auto &in : b.insts) {
+                if(in.op == irOp::call) leaf = false;
             }
         }
+        adjust = leaf && ra->frameSize() + 8 <= redZone ? 0 : ra->frameSize() + 8;
+        if(adjust) emit.emit(opcode::sub,operand::imm(adjust),operand::r(reg::rsp));
+    }else {
+        emit.emit(opcode::push,operand::r(reg::rbp));
+        emit.emit(opcode::mov,operand::r(reg::rsp),operand::r(reg::rbp));
+        if(ra->frameSize()) emit.emit(opcode::sub,operand::imm(ra->frameSize()),operand::r(reg::rsp));
     }
-    else{
-        for(auto &var : decls) {
-            if(var->equal(Node::Kind::N_binary) || var->equal(Node::Kind::N_arraydef)) {
-                var->accept(*this);
-            }
-        }
+    auto &saved = ra->calleeSaved();
+    for(size_t i = 0; i < saved.size(); i++) {
+        emit.emit(opcode::mov,operand::r(saved[i]),frame(ra->saveOffset(i)));
     }
-}
-
 
-void codegenerator::visit(funcdef& f) {
-    auto name = f.getName();
-    int stackoff = f.getStackOff();
-    auto &params = f.getParams();
-    auto &body = f.getBody();
+    for(size_t i = 0; i < f.blocks.size(); i++) {
+        gen(f.blocks[i],i);
+    }
 
-    retStmt::setFuncName(name);
-    std::cout << std::format("  .globl {}\n  .text\n{}:\n",name,name);
-    std::cout << std::format("  push %rbp\n  mov %rsp,%rbp\n  sub ${},%rsp\n",stackoff);
-    std::array<const char *,6> regs{ "%rdi","%rsi","%rdx","%rcx","%r8","%r9" };
-    for(size_t i = 0; i < params.size(); i++) {
-        std::cout << std::format("  mov {},{}(%rbp)\n",regs[i],static_cast<identNode*>(params[i].get())->getOffset());
+    // every return may have left through a tail call
+    bool returns = false;
+    for(auto &b : f.blocks) {
+        returns |= b.terminator().op == irOp::ret && !(tailCalls && b.isTailCall(b.insts.size() - 2));
     }
-    body->accept(*this);
-    std::cout <<  std::format(".L.{}.ret:\n  mov %rbp,%rsp\n  pop %rbp\n  ret\n",name);
+    if(!returns) return;
+    emit.emit(opcode::label,operand::symbol(retLabel));
+    epilogue();
+    emit.emit(opcode::ret);
 }
 
 
-void codegenerator::visit(blockStmt& S) {
-    S.compileStmts(*this);
+// is str[i] where a character of the literal's source text starts, and not inside an escape?
+static bool charStart(std::string_view str,size_t i) {
+    size_t k = 0;
+    while(k < i) {
+        if(str[k++] != '\\' || k == str.size()) continue;
+        char c = str[k++];
+        if(c == 'x') {
+            while(k < str.size() && isxdigit(static_cast<unsigned char>(str[k]))) k++;
+        }else if(c >= '0' && c <= '7') {
+            for(int n = 0; n < 2 && k < str.size() && str[k] >= '0' && str[k] <= '7'; n++) k++;
+        }
+    }
+    return k == i;
 }
 
-void codegenerator::visit(Prog& p) {
-    for(auto &stmt : p._stmts) {
-        stmt->accept(*this);
+
+/*
+ * the string literals, in the section the linker merges across objects.
+ * a literal that ends another one is not stored again: its label goes
+ * inside the longer one. sorted by their reversed text, each literal is
+ * followed by the ones it ends, if there are any.
+ */
+void codegenerator::genStrings(const irModule& m) {
+    std::vector<const irGlobal*> strs;
+    for(auto &g : m.globals) {
+        if(g.is_string) strs.push_back(&g);
+    }
+    if(strs.empty()) return;
+    std::sort(strs.begin(),strs.end(),[](const irGlobal *a,const irGlobal *b) {
+        return std::lexicographical_compare(a->str.rbegin(),a->str.rend(),b->str.rbegin(),b->str.rend());
+    });
+    emit.emit(opcode::strings);
+    size_t first = 0;
+    for(size_t i = 0; i < strs.size(); i++) {
+        const std::string &s = strs[i]->str;
+        if(i + 1 < strs.size()) {
+            const std::string &t = strs[i + 1]->str;
+            if(t.ends_with(s) && charStart(t,t.size() - s.size())) continue;
+        }
+        // strs[i] holds strs[first..i], labelled from the longest down
+        size_t pos = 0;
+        for(size_t k = i + 1; k-- > first;) {
+            size_t at = s.size() - strs[k]->str.size();
+            if(at > pos) emit.ascii(std::string_view(s).substr(pos,at - pos));
+            pos = at;
+            emit.label(strs[k]->name);
+        }
+        emit.string(std::string_view(s).substr(pos));
+        first = i + 1;
     }
 }
 
+
+void codegenerator::gen(const irModule& m) {
+    mod = &m;
+    for(auto &g : m.globals) {
+        if(g.is_string) continue;
+        if(g.readonly) {
+            emit.emit(opcode::rodata);
+        }else {
+            emit.globl(g.name);
+            emit.emit(opcode::data);
+        }
+        emit.label(g.name);
+        for(auto &d : g.init) {
+            if(g.elem == 1) {
+                emit.emit(opcode::byte,operand::imm(static_cast<int8_t>(d.v)));
+            }else if(d.sym >= 0) {
+                operand o = operand::symbol(emit.intern(m.symName(d.sym)));
+                o.val = d.v;
+                emit.emit(opcode::quad,o);
+            }else {
+                emit.emit(opcode::quad,operand::imm(d.v));
+            }
+        }
+        size_t rest = g.size - g.init.size() * g.elem;
+        if(rest || g.init.empty()) emit.emit(opcode::zero,operand::imm(rest));
+    }
+    genStrings(m);
+    for(auto &f : m.funcs) {
+        gen(f);
+    }
+}
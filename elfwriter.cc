@@ -0,0 +1,149 @@
+#include "include/elfwriter.h"
+
+#include <elf.h>
+#include <cstdio>
+#include <cstring>
+
+static const char *secnames[] = { ".text",".data",".rodata",".rodata.str1.1" };
+
+
+template<typename T> static size_t append(std::string& buf,const T& v) {
+    size_t off = buf.size();
+    buf.append(reinterpret_cast<const char*>(&v),sizeof(T));
+    return off;
+}
+
+
+static void align(std::string& buf,size_t n) {
+    buf.resize((buf.size() + n - 1) / n * n,'\0');
+}
+
+
+static uint32_t addString(std::string& tab,std::string_view s) {
+    uint32_t off = tab.size();
+    tab.append(s);
+    tab.push_back('\0');
+    return off;
+}
+
+
+void elfwriter::build(std::string& buf)const {
+    std::vector<Elf64_Shdr> shdrs(1);
+    std::string shstrtab(1,'\0');
+    auto section = [&](std::string_view name,uint32_t type,uint64_t flags,size_t off,size_t size,uint64_t align) {
+        Elf64_Shdr sh{};
+        sh.sh_name = addString(shstrtab,name);
+        sh.sh_type = type;
+        sh.sh_flags = flags;
+        sh.sh_offset = off;
+        sh.sh_size = size;
+        sh.sh_addralign = align;
+        shdrs.push_back(sh);
+        return shdrs.size() - 1;
+    };
+
+    buf.assign(sizeof(Elf64_Ehdr),'\0');
+
+    // contents of .text/.data/.rodata, and the string literals the linker may merge with others
+    static const uint64_t flags[] = { SHF_ALLOC | SHF_EXECINSTR,SHF_ALLOC | SHF_WRITE,SHF_ALLOC,SHF_ALLOC | SHF_MERGE | SHF_STRINGS };
+    static const uint64_t aligns[] = { 16,8,8,1 };
+    size_t secidx[assembler::S_count];
+    for(int s = 0; s < assembler::S_count; s++) {
+        align(buf,16);
+        auto &bytes = as.bytes(s);
+        size_t off = buf.size();
+        buf.append(reinterpret_cast<const char*>(bytes.data()),bytes.size());
+        secidx[s] = section(secnames[s],SHT_PROGBITS,flags[s],off,bytes.size(),aligns[s]);
+    }
+    shdrs[secidx[assembler::S_strings]].sh_entsize = 1;
+    section(".note.GNU-stack",SHT_PROGBITS,0,buf.size(),0,1);
+
+    // symbol table: locals first, as the format requires
+    auto &syms = as.symbols();
+    std::vector<uint32_t> symidx(syms.size());
+    std::vector<Elf64_Sym> symtab(1);
+    std::string strtab(1,'\0');
+    size_t nlocal = 1;
+    for(int pass = 0; pass < 2; pass++) {
+        for(size_t i = 0; i < syms.size(); i++) {
+            auto &s = syms[i];
+            if(s.global != (pass == 1)) continue;
+            Elf64_Sym es{};
+            es.st_name = addString(strtab,s.name);
+            int type = s.section < 0 ? STT_NOTYPE : s.section == assembler::S_text ? STT_FUNC : STT_OBJECT;
+            es.st_info = ELF64_ST_INFO(s.global ? STB_GLOBAL : STB_LOCAL,type);
+            es.st_shndx = s.section < 0 ? SHN_UNDEF : secidx[s.section];
+            es.st_value = s.value;
+            es.st_size = s.size;
+            symidx[i] = symtab.size();
+            symtab.push_back(es);
+        }
+        if(pass == 0) nlocal = symtab.size();
+    }
+
+    align(buf,8);
+    size_t symoff = buf.size();
+    for(auto &es : symtab) append(buf,es);
+    size_t symsec = section(".symtab",SHT_SYMTAB,0,symoff,symtab.size() * sizeof(Elf64_Sym),8);
+    shdrs[symsec].sh_entsize = sizeof(Elf64_Sym);
+    shdrs[symsec].sh_info = nlocal;
+
+    size_t stroff = buf.size();
+    buf += strtab;
+    shdrs[symsec].sh_link = section(".strtab",SHT_STRTAB,0,stroff,strtab.size(),1);
+
+    // one .rela section per section that has relocations
+    for(int s = 0; s < assembler::S_count; s++) {
+        align(buf,8);
+        size_t off = buf.size(),n = 0;
+        for(auto &r : as.relocs()) {
+            if(r.section != s) continue;
+            Elf64_Rela rela{};
+            rela.r_offset = r.offset;
+            rela.r_info = ELF64_R_INFO(symidx[r.sym],r.type);
+            rela.r_addend = r.addend;
+            append(buf,rela);
+            n++;
+        }
+        if(n == 0) continue;
+        size_t idx = section(std::string(".rela") + secnames[s],SHT_RELA,SHF_INFO_LINK,off,n * sizeof(Elf64_Rela),8);
+        shdrs[idx].sh_entsize = sizeof(Elf64_Rela);
+        shdrs[idx].sh_link = symsec;
+        shdrs[idx].sh_info = secidx[s];
+    }
+
+    size_t shstrsec = section(".shstrtab",SHT_STRTAB,0,0,0,1);
+    shdrs[shstrsec].sh_offset = buf.size();
+    shdrs[shstrsec].sh_size = shstrtab.size();
+    buf += shstrtab;
+
+    align(buf,8);
+    size_t shoff = buf.size();
+    for(auto &sh : shdrs) append(buf,sh);
+
+    Elf64_Ehdr eh{};
+    std::memcpy(eh.e_ident,ELFMAG,SELFMAG);
+    eh.e_ident[EI_CLASS] = ELFCLASS64;
+    eh.e_ident[EI_DATA] = ELFDATA2LSB;
+    eh.e_ident[EI_VERSION] = EV_CURRENT;
+    eh.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    eh.e_type = ET_REL;
+    eh.e_machine = EM_X86_64;
+    eh.e_version = EV_CURRENT;
+    eh.e_shoff = shoff;
+    eh.e_ehsize = sizeof(Elf64_Ehdr);
+    eh.e_shentsize = sizeof(Elf64_Shdr);
+    eh.e_shnum = shdrs.size();
+    eh.e_shstrndx = shstrsec;
+    std::memcpy(buf.data(),&eh,sizeof(eh));
+}
+
+
+bool elfwriter::write(const char *path)const {
+    std::string buf;
+    build(buf);
+    FILE *fp = std::fopen(path,"wb");
+    if(fp == nullptr) return false;
+    bool ok = std::fwrite(buf.data(),1,buf.size(),fp) == buf.size();
+    return std::fclose(fp) == 0 && ok;
+}
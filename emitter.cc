@@ -0,0 +1,186 @@
+#include "include/emitter.h"
+
+#include <charconv>
+#include <cstdio>
+
+static const char *regs64[] = {
+    "rax","rcx","rdx","rbx","rsp","rbp","rsi","rdi",
+    "r8","r9","r10","r11","r12","r13","r14","r15","rip",
+};
+static const char *regs32[] = {
+    "eax","ecx","edx","ebx","esp","ebp","esi","edi",
+    "r8d","r9d","r10d","r11d","r12d","r13d","r14d","r15d",
+};
+static const char *regs8[] = {
+    "al","cl","dl","bl","spl","bpl","sil","dil",
+    "r8b","r9b","r10b","r11b","r12b","r13b","r14b","r15b",
+};
+
+static const char *opnames[] = {
+    "","  .globl ","  .text","  .data","  .section .rodata",
+    "  .section .rodata.str1.1,\"aMS\",@progbits,1","  .string ","  .ascii ","  .zero ",
+    "  .byte ","  .quad ",
+    "mov","movsbq","movzbq","lea","add","sub","imul","idiv","cqo","neg","cmp","shl","sar",
+    "sete","setne","setl","setle","setg","setge",
+    "jmp","je","jne","jl","jle","jg","jge",
+    "call","ret","push","pop",
+    "nop","rep movsb","rep stosb",
+    "movq","movdqa","movdqu","paddb","paddq","psubb","psubq","pxor",
+    "punpcklbw","punpcklwd","punpckldq","punpcklqdq","punpckhqdq",
+    "vmovq","vmovdqa","vmovdqu","vpaddb","vpaddq","vpsubb","vpsubq","vpxor","vpunpckhqdq",
+    "vpbroadcastb","vpbroadcastq","vextracti128","vzeroupper",
+};
+
+
+static bool sized(opcode op) {
+    switch(op) {
+        case opcode::mov: case opcode::add: case opcode::sub: case opcode::imul:
+        case opcode::idiv: case opcode::neg: case opcode::cmp:
+        case opcode::shl: case opcode::sar:
+        case opcode::push: case opcode::pop:
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+// VEX forms whose destination is also their first source
+static bool nds(opcode op) {
+    switch(op) {
+        case opcode::vpaddb: case opcode::vpaddq: case opcode::vpsubb: case opcode::vpsubq:
+        case opcode::vpxor: case opcode::vpunpckhqdq:
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+int32_t emitter::intern(std::string_view name) {
+    auto it = _symids.find(name);
+    if(it != _symids.end()) return it->second;
+    std::string_view s = _names.copy(name);
+    int32_t id = _syms.size();
+    _syms.push_back(s);
+    _symids.emplace(s,id);
+    return id;
+}
+
+
+static void append_int(std::string& buf,int64_t v) {
+    char tmp[24];
+    auto res = std::to_chars(tmp,tmp + sizeof(tmp),v);
+    buf.append(tmp,res.ptr);
+}
+
+
+void emitter::print(std::string& buf,const operand& o)const {
+    switch(o.kind) {
+        case operand::Kind::O_reg: {
+            buf.push_back('%');
+            int r = static_cast<int>(o.base);
+            if(o.isVec()) {
+                buf += o.size == 32 ? "ymm" : "xmm";
+                append_int(buf,r);
+                break;
+            }
+            buf += o.size == 1 ? regs8[r] : o.size == 4 ? regs32[r] : regs64[r];
+            break;
+        }
+        case operand::Kind::O_imm:
+            buf.push_back('$');
+            append_int(buf,o.val);
+            break;
+        case operand::Kind::O_mem:
+            if(o.sym >= 0) {
+                buf += name(o.sym);
+                if(o.val > 0) buf.push_back('+');
+                if(o.val != 0) append_int(buf,o.val);
+            }else if(o.val != 0) {
+                append_int(buf,o.val);
+            }
+            buf.push_back('(');
+            if(o.base != reg::none) {
+                buf.push_back('%');
+                buf += regs64[static_cast<int>(o.base)];
+            }
+            if(o.index != reg::none) {
+                buf += ",%";
+                buf += regs64[static_cast<int>(o.index)];
+                buf.push_back(',');
+                append_int(buf,o.scale);
+            }
+            buf.push_back(')');
+            break;
+        case operand::Kind::O_sym:
+            buf += name(o.sym);
+            if(o.val > 0) buf.push_back('+');
+            if(o.val != 0) append_int(buf,o.val);
+            break;
+        default:break;
+    }
+}
+
+
+void emitter::print(std::string& buf)const {
+    buf.reserve(buf.size() + _insts.size() * 20);
+    for(const inst& i : _insts) {
+        switch(i.op) {
+            case opcode::label:
+                buf += name(i.a.sym);
+                buf += ":\n";
+                continue;
+            case opcode::string:
+            case opcode::ascii:
+                buf += opnames[static_cast<int>(i.op)];
+                buf.push_back('"');
+                buf += name(i.a.sym);
+                buf += "\"\n";
+                continue;
+            case opcode::globl:
+            case opcode::text:
+            case opcode::data:
+            case opcode::rodata:
+            case opcode::strings:
+            case opcode::zero:
+            case opcode::byte:
+            case opcode::quad:
+                buf += opnames[static_cast<int>(i.op)];
+                if(i.a.kind == operand::Kind::O_imm) append_int(buf,i.a.val);
+                else print(buf,i.a);
+                buf.push_back('\n');
+                continue;
+            default:break;
+        }
+        buf += "  ";
+        buf += opnames[static_cast<int>(i.op)];
+        // without a register operand nothing implies the width of a memory access
+        if((i.a.isMem() || i.b.isMem()) && !i.a.isReg() && !i.b.isReg() && sized(i.op))
+            buf.push_back('q');
+        if(i.op == opcode::vextracti128) buf += " $1,";
+        else if(i.a.kind != operand::Kind::O_none) buf.push_back(' ');
+        if(i.a.kind != operand::Kind::O_none) print(buf,i.a);
+        if(i.b.kind != operand::Kind::O_none) {
+            buf.push_back(',');
+            print(buf,i.b);
+        }
+        if(nds(i.op)) {
+            buf.push_back(',');
+            print(buf,i.b);
+        }
+        buf.push_back('\n');
+    }
+}
+
+
+bool emitter::write(const char *path)const {
+    std::string buf;
+    print(buf);
+    FILE *fp = path ? std::fopen(path,"w") : stdout;
+    if(fp == nullptr) return false;
+    bool ok = std::fwrite(buf.data(),1,buf.size(),fp) == buf.size();
+    if(path) ok = std::fclose(fp) == 0 && ok;
+    else ok = std::fflush(fp) == 0 && ok;
+    return ok;
+}
@@ -0,0 +1,91 @@
+#include "include/gvn.h"
+
+#include <algorithm>
+
+
+size_t gvn::hash::operator()(const key& k)const {
+    size_t h = static_cast<size_t>(k.op);
+    for(const irVal& v : { k.a,k.b }) h = h * 31 + static_cast<size_t>(v.kind) * 7 + static_cast<size_t>(v.v);
+    return (h * 31 + k.size) * 31 + static_cast<size_t>(k.memory);
+}
+
+
+static bool pure(irOp op) {
+    switch(op) {
+        case irOp::add: case irOp::sub: case irOp::mul: case irOp::div:
+        case irOp::shl: case irOp::sar: case irOp::neg:
+        case irOp::lt: case irOp::le: case irOp::gt:
+        case irOp::ge: case irOp::eq: case irOp::ne:
+        case irOp::addr:
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+// operands in a fixed order, so that a+b and b+a or a<b and b>a look alike
+static void normalize(irOp& op,irVal& a,irVal& b) {
+    auto less = [](const irVal& x,const irVal& y) { return x.kind != y.kind ? x.kind < y.kind : x.v < y.v; };
+    if(op == irOp::gt || op == irOp::ge) {
+        op = irSwapped(op);
+        std::swap(a,b);
+    }
+    bool commutative = op == irOp::add || op == irOp::mul || op == irOp::eq || op == irOp::ne;
+    if(commutative && less(b,a)) std::swap(a,b);
+}
+
+
+irVal gvn::resolve(const irVal& v)const {
+    return v.isReg() && !replace[v.v].isNone() ? replace[v.v] : v;
+}
+
+
+void gvn::visit(int b) {
+    auto &blk = func.blocks[b];
+    // memory is as the only predecessor, which dominates b, left it
+    int memory = b != 0 && blk.preds.size() == 1 ? memoryOut[blk.preds[0]] : ++memories;
+    size_t mark = scope.size();
+    auto record = [&](const key& k,const irVal& v) {
+        if(table.emplace(k,v).second) scope.push_back(k);
+    };
+    for(auto &in : blk.insts) {
+        in.mapUses([&](irVal& v) { v = resolve(v); });
+        if(in.writesMemory()) {
+            memory = ++memories;
+            // a narrower load would read back the value truncated
+            if(in.op == irOp::store && in.size == 8) record({irOp::load,in.a,{},8,memory},in.b);
+            continue;
+        }
+        if(in.dst < 0 || !(pure(in.op) || in.op == irOp::load)) continue;
+        key k{in.op,in.a,in.b,0,0};
+        if(in.op == irOp::load) {
+            k.size = in.size;
+            k.memory = memory;
+        }else {
+            normalize(k.op,k.a,k.b);
+        }
+        auto it = table.find(k);
+        if(it != table.end()) replace[in.dst] = it->second;
+        else record(k,irVal::reg(in.dst));
+    }
+    memoryOut[b] = memory;
+    for(int c : form.dominated(b)) visit(c);
+    while(scope.size() > mark) {
+        table.erase(scope.back());
+        scope.pop_back();
+    }
+}
+
+
+void gvn::run() {
+    form.computeDominators();
+    replace.assign(func.nregs,{});
+    memoryOut.assign(func.blocks.size(),0);
+    visit(0);
+    // phis read values along back edges, from blocks visited later
+    for(auto &b : func.blocks) {
+        for(auto &in : b.insts) in.mapUses([&](irVal& v) { v = resolve(v); });
+    }
+    form.eliminateDeadCode();
+}
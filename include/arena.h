@@ -0,0 +1,94 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * bump-pointer allocator: memory is handed out from large chunks and
+ * released all at once when the arena dies. objects built with make()
+ * have their destructors run then too, last made first.
+ */
+class arena {
+public:
+    explicit arena(size_t chunk = 64 * 1024):_chunk(chunk) {}
+    arena(const arena&)=delete;
+    arena& operator=(const arena&)=delete;
+    ~arena() {
+        for(auto *f = _finalizers; f; f = f->next) f->destroy(f->obj);
+    }
+
+    void *alloc(size_t size,size_t align = alignof(std::max_align_t)) {
+        size_t pad = (align - reinterpret_cast<uintptr_t>(_cur) % align) % align;
+        if(_cur == nullptr || pad + size > static_cast<size_t>(_end - _cur)) {
+            grow(size + align);
+            pad = (align - reinterpret_cast<uintptr_t>(_cur) % align) % align;
+        }
+        void *p = _cur + pad;
+        _cur += pad + size;
+        _used += pad + size;
+        return p;
+    }
+
+    std::string_view copy(std::string_view s) {
+        char *p = static_cast<char *>(alloc(s.size() + 1,1));
+        std::memcpy(p,s.data(),s.size());
+        p[s.size()] = '\0';
+        return std::string_view(p,s.size());
+    }
+
+    template<typename T,typename... Args>
+    T *make(Args&&... args) {
+        T *obj = new(alloc(sizeof(T),alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr(!std::is_trivially_destructible_v<T>) {
+            auto *f = static_cast<finalizer*>(alloc(sizeof(finalizer),alignof(finalizer)));
+            *f = {[](void *p) { static_cast<T*>(p)->~T(); },obj,_finalizers};
+            _finalizers = f;
+        }
+        return obj;
+    }
+
+    // the elements of v, copied into the arena
+    template<typename T>
+    std::span<T> copy(const std::vector<T>& v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if(v.empty()) return {};
+        T *p = static_cast<T*>(alloc(v.size() * sizeof(T),alignof(T)));
+        std::memcpy(p,v.data(),v.size() * sizeof(T));
+        return std::span<T>(p,v.size());
+    }
+
+    size_t used()const { return _used; }
+    size_t reserved()const { return _reserved; }
+private:
+    struct finalizer {
+        void (*destroy)(void *);
+        void *obj;
+        finalizer *next;
+    };
+
+    void grow(size_t atleast) {
+        size_t size = atleast > _chunk ? atleast : _chunk;
+        _chunks.emplace_back(new char[size]);
+        _cur = _chunks.back().get();
+        _end = _cur + size;
+        _reserved += size;
+    }
+
+    size_t _chunk;
+    char *_cur{nullptr};
+    char *_end{nullptr};
+    size_t _used{0};
+    size_t _reserved{0};
+    finalizer *_finalizers{nullptr};
+    std::vector<std::unique_ptr<char[]>> _chunks;
+};
+#endif
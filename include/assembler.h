@@ -0,0 +1,94 @@
+#ifndef ASSEMBLER_H_
+#define ASSEMBLER_H_
+
+#include "emitter.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/*
+ * x86-64 machine-code encoder: turns the emitter records into section
+ * contents, a symbol table and relocations, the pieces an object file
+ * writer or an in-memory loader needs. jumps to local .L labels are
+ * resolved here; every other reference stays a relocation.
+ */
+class assembler {
+public:
+    enum section : uint8_t { S_text,S_data,S_rodata,S_strings,S_count };
+
+    struct symbol {
+        std::string_view name;
+        int section{-1};        // -1 when undefined
+        uint64_t value{0};
+        uint64_t size{0};
+        bool global{false};
+    };
+
+    struct reloc {
+        int section;
+        uint64_t offset;
+        int32_t sym;            // index into symbols()
+        uint32_t type;          // R_X86_64_*
+        int64_t addend;
+    };
+
+    explicit assembler(const emitter& e);
+
+    bool run();
+    const std::string& error()const { return _error; }
+
+    const std::vector<uint8_t>& bytes(int s)const { return _sections[s]; }
+    const std::vector<symbol>& symbols()const { return _symbols; }
+    const std::vector<reloc>& relocs()const { return _relocs; }
+private:
+    struct label {
+        int section{-1};
+        uint64_t offset{0};
+        bool global{false};
+    };
+    // a 32-bit pc-relative field waiting for its target
+    struct fixup {
+        int section;
+        uint64_t offset;        // of the rel32 field
+        uint64_t end;           // of the instruction, which rel32 is relative to
+        int32_t sym;            // emitter symbol id
+        int64_t disp;
+        bool branch;            // call/jmp (PLT32) rather than a data reference (PC32)
+    };
+    // a .quad holding a symbol's address, always left to the linker or loader
+    struct address {
+        int section;
+        uint64_t offset;
+        int32_t sym;            // emitter symbol id
+        int64_t addend;
+    };
+
+    bool encode(const inst& in);
+    void encodeMov(const inst& in);
+    void encodeAlu(const inst& in,uint8_t digit,uint8_t rm_r,uint8_t r_rm);
+    void encodeImul(const inst& in);
+    void encodeSimd(const inst& in);
+    void encodeBranch(std::initializer_list<uint8_t> opc,int32_t sym);
+    void encodeString(std::string_view str,bool nul);
+
+    void rm(std::initializer_list<uint8_t> opc,int r,const operand& m,bool w,bool byteop = false,int immsize = 0,int64_t imm = 0);
+    void modrm(int r,const operand& m,int immsize,int64_t imm);
+    void put(uint8_t b) { _sections[cur].push_back(b); }
+    void put32(uint32_t v);
+    void put64(uint64_t v);
+    bool isLocal(int32_t sym)const;
+    int32_t symbolIndex(int32_t sym);
+
+    const emitter& emit;
+    int cur{S_text};
+    std::vector<uint8_t> _sections[S_count];
+    std::vector<label> labels;                  // indexed by emitter symbol id
+    std::vector<fixup> fixups;
+    std::vector<address> addresses;
+    std::vector<int32_t> symindex;              // emitter symbol id -> symbols() index
+    std::vector<symbol> _symbols;
+    std::vector<reloc> _relocs;
+    std::string _error;
+};
+#endif
@@ -10,7 +10,7 @@
 #include <string>
 #include <map>
 #include <unordered_set>
-#include <memory>
+#include <span>
 #include <functional>
 #include <format>
 #include <vector>
@@ -22,7 +22,7 @@ public:
     Node()=default;
     virtual ~Node()=default;
 
-    virtual std::shared_ptr<Type> getType()const=0;
+    virtual Type *getType()const=0;
     virtual size_t typeSize()const=0;
     virtual size_t strLength()const=0;
     virtual size_t strStart()const=0;
@@ -34,149 +34,150 @@ public:
 
 class numericNode final: public Node {
 public:
-    numericNode(int val,const token& tok):
+    numericNode(int64_t val,const token& tok):
                _value(val),
                _tok(tok) {}
     numericNode()=default;
     ~numericNode()=default;
     
-    std::shared_ptr<Type> getType()const override { return ty; }
+    Type *getType()const override { return ty; }
     size_t typeSize()const override { return ty->getSize(); };
     bool equal(Node::Kind kind)const override { return kind == Kind::N_number; }
     
     size_t strLength()const override{ return _tok.str.length(); }
     size_t strStart()const override{ return _tok.start; }
-    std::string strView()const override { return _tok.str; }
+    std::string strView()const override { return std::string(_tok.str); }
 
-    int Value()const { return _value; }
+    int64_t Value()const { return _value; }
 
     void accept(visitor& vis) override{ vis.visit(*this); }
 private:
-    int _value;
+    int64_t _value;
     token _tok;
-    static inline std::shared_ptr<Type> ty = typeFactor::getInt();
+    static inline Type *ty = typeFactor::getInt();
 };
 
 
 class stringNode final : public Node {
 public:
-    stringNode(const token &tok):_tok(tok),l(label++) {}
+    // the label of the literal's entry in the unit's string pool
+    stringNode(const token &tok,int label):_tok(tok),l(label) {}
     ~stringNode()=default;
 
-    std::shared_ptr<Type> getType()const override { return ty;}
+    Type *getType()const override { return ty;}
     size_t typeSize()const override { return ty->getSize(); };
     bool equal(Node::Kind kind)const override { return kind == Kind::N_string; }
 
     size_t strLength()const override{ return _tok.str.length(); }
     size_t strStart()const override{ return _tok.start; }
-    std::string strView()const override { return _tok.str; }
+    std::string strView()const override { return std::string(_tok.str); }
 
     void accept(visitor& vis) override { vis.visit(*this); }
     int get_label()const { return l; }
+    std::string symbol()const { return std::format(".L.str.{}",l); }
 private:
     token _tok;
     int l;
-    static inline int label = 0;
-    static inline std::shared_ptr<Type> ty = typeFactor::getPointerType(typeFactor::getChar());
+    static inline Type *ty = typeFactor::getPointerType(typeFactor::getChar());
 };
 
 
 class identNode final: public Node {
 public:
-    identNode(const SymbolInfo &info): _info(info) {}
+    identNode(const SymbolInfo *info): _info(info) {}
     identNode()=default;
     ~identNode()=default;
 
-    std::string getName()const { return _info._tok.str; }
+    std::string getName()const { return std::string(_info->_tok.str); }
 
-    std::shared_ptr<Type> getType()const override { return _info._type; }
-    size_t typeSize()const override { return _info._type->getSize(); }
+    Type *getType()const override { return _info->_type; }
+    size_t typeSize()const override { return _info->_type->getSize(); }
     bool equal(Node::Kind kind)const override { return kind == Kind::N_identifier; }
     void accept(visitor& vis) override{ vis.visit(*this); }
 
 
-    size_t strLength()const override{ return _info._tok.str.length(); }
-    std::string strView()const override { return _info._tok.str; }
-    size_t strStart()const override { return _info._tok.start; };
+    size_t strLength()const override{ return _info->_tok.str.length(); }
+    std::string strView()const override { return std::string(_info->_tok.str); }
+    size_t strStart()const override { return _info->_tok.start; };
 
-    bool isGlobal() { return _info._isglobal; }
-    int  getOffset() { return _info._offset; }
+    bool isGlobal() { return _info->_isglobal; }
+    int  getOffset() { return _info->_offset; }
 private:
-    SymbolInfo _info;
+    const SymbolInfo *_info{nullptr};
 };
 
 
 class arrayVisit final : public Node {
 public:
-    arrayVisit(const SymbolInfo& info, std::shared_ptr<Node> idx): _info(info), _idx(idx) {
-        if(Type::isArray(_info._type)) {
-            _baseTy = static_cast<arrayType*>(_info._type.get())->elemTy();
+    arrayVisit(const SymbolInfo *info, Node *idx): _info(info), _idx(idx) {
+        if(Type::isArray(_info->_type)) {
+            _baseTy = static_cast<arrayType*>(_info->_type)->elemTy();
             _is_array = true;
         }else {
-            _baseTy = static_cast<pointerType*>(_info._type.get())->getBaseType();
+            _baseTy = static_cast<pointerType*>(_info->_type)->getBaseType();
             _is_array = false;
         }
     }
     ~arrayVisit()=default;
 
-    bool isGlobal()const { return _info._isglobal; }
+    bool isGlobal()const { return _info->_isglobal; }
     bool isArray()const { return _is_array; }
 
-    std::string getName()const { return _info._tok.str; }
-    int getOffset()const { return _info._offset; }
-    std::shared_ptr<Node> get_idx()const { return _idx; }
+    std::string getName()const { return std::string(_info->_tok.str); }
+    int getOffset()const { return _info->_offset; }
+    Node *get_idx()const { return _idx; }
 
     size_t typeSize()const override{ return _baseTy->getSize(); }
-    std::shared_ptr<Type> getType()const override { return _baseTy; }
+    Type *getType()const override { return _baseTy; }
     
     bool equal(Node::Kind kind)const override { return kind == Kind::N_arrayvisit; }
-    size_t strLength()const override{ return _info._tok.str.length(); }
-    size_t strStart()const override{ return _info._tok.start; }
-    std::string strView()const override { return _info._tok.str; }
+    size_t strLength()const override{ return _info->_tok.str.length(); }
+    size_t strStart()const override{ return _info->_tok.start; }
+    std::string strView()const override { return std::string(_info->_tok.str); }
 
     void accept(visitor& vis) override{ vis.visit(*this); }
 private:
-    SymbolInfo _info;
-    std::shared_ptr<Node> _idx;
-    std::shared_ptr<Type> _baseTy;
+    const SymbolInfo *_info{nullptr};
+    Node *_idx{nullptr};
+    Type *_baseTy{nullptr};
     bool _is_array;
 };
 
 
 class arraydef final : public Node {
 public:
-    arraydef( const SymbolInfo &info,
-             std::vector<std::shared_ptr<Node>>& init):
+    arraydef( const SymbolInfo *info,
+             std::span<Node*> init):
             _info(info),
-            _init_lst(std::move(init)) {}
+            _init_lst(init) {}
     arraydef()=default;
     ~arraydef()=default;
 
-    std::string getName()const { return _info._tok.str; }
+    std::string getName()const { return std::string(_info->_tok.str); }
 
-    size_t typeSize()const override{ return _info._type->getSize(); }
-    size_t elemSize()const { return static_cast<arrayType*>(_info._type.get())->elemSize(); }
-    std::shared_ptr<Type> getType()const override {  return _info._type; }
+    size_t typeSize()const override{ return _info->_type->getSize(); }
+    size_t elemSize()const { return static_cast<arrayType*>(_info->_type)->elemSize(); }
+    Type *getType()const override {  return _info->_type; }
     bool equal(Node::Kind kind)const override { return kind == Kind::N_arraydef; }
 
-    size_t strLength()const override{ return _info._tok.str.length(); }
+    size_t strLength()const override{ return _info->_tok.str.length(); }
     std::string strView()const override { return getName(); }
-    size_t strStart()const override{ return _info._tok.start; }
+    size_t strStart()const override{ return _info->_tok.start; }
 
-    bool isGlobal() { return _info._isglobal; }
-    int  getOffset() { return _info._offset; }
+    bool isGlobal() { return _info->_isglobal; }
+    int  getOffset() { return _info->_offset; }
     void accept(visitor& vis) override{ vis.visit(*this); }
-    const std::vector<std::shared_ptr<Node>>& get_init_lst()const { return _init_lst; }
+    std::span<Node*> get_init_lst()const { return _init_lst; }
 private:
-    SymbolInfo _info;
-    std::vector<std::shared_ptr<Node>> _init_lst;
+    const SymbolInfo *_info{nullptr};
+    std::span<Node*> _init_lst;
 };
 
 
 class prefixNode final: public Node {
 public:
-    prefixNode(std::shared_ptr<Node> expr,
-               std::shared_ptr<Type> type,
+    prefixNode(Node *expr,
+               Type *type,
                Kind kind, token tok):
               _expr(expr),
               _type(type),
@@ -187,18 +188,18 @@ public:
 
     void accept(visitor& vis) override{ vis.visit(*this); }
 
-    std::shared_ptr<Type> getType()const override { return _type; }
+    Type *getType()const override { return _type; }
     size_t typeSize()const override { return _type->getSize(); };
 
-    std::shared_ptr<Node> getNode()const { return _expr; }
+    Node *getNode()const { return _expr; }
     bool equal(Node::Kind kind)const override { return kind == _kind; }
 
     size_t strLength()const override{ return _tok.str.length() + _expr->strLength(); }
     size_t strStart()const override{ return _tok.start; }
     std::string strView()const override { return std::string(_tok.str.data(),1) + _expr->strView(); }
 private:
-    std::shared_ptr<Node> _expr;
-    std::shared_ptr<Type> _type;
+    Node *_expr{nullptr};
+    Type *_type{nullptr};
     Kind _kind;
     token _tok;
 };
@@ -207,9 +208,9 @@ private:
 class binaryNode final: public Node {
 public:
     binaryNode(token op,
-               std::shared_ptr<Node> lhs,
-               std::shared_ptr<Node> rhs,
-               std::shared_ptr<Type> type):
+               Node *lhs,
+               Node *rhs,
+               Type *type):
                _op(op),
                _lhs(lhs),
                _rhs(rhs),
@@ -219,12 +220,15 @@ public:
     ~binaryNode()=default;
 
     void accept(visitor& vis) override{ vis.visit(*this); }
-    virtual std::shared_ptr<Type> getType()const override { return _type; }
+    virtual Type *getType()const override { return _type; }
     virtual size_t typeSize()const override { return _type->getSize(); }
 
     tokenType getOp()const { return _op.type; }
-    std::shared_ptr<Node> getLhs()const { return _lhs; }
-    std::shared_ptr<Node> getRhs()const { return _rhs; }
+    // a division known to leave no remainder, like a pointer difference
+    void setExact() { _exact = true; }
+    bool isExact()const { return _exact; }
+    Node *getLhs()const { return _lhs; }
+    Node *getRhs()const { return _rhs; }
     bool equal(Node::Kind kind)const override { return kind == Node::Kind::N_binary; }
 
     size_t strLength()const override { return _op.str.length() + _lhs->strLength() + _rhs->strLength(); }
@@ -232,39 +236,40 @@ public:
     std::string strView()const override { return _lhs->strView() + std::string(_op.str.data(),_op.str.length()) + _rhs->strView();}
 private:
     token _op;
-    std::shared_ptr<Node> _lhs;
-    std::shared_ptr<Node> _rhs;
-    std::shared_ptr<Type> _type;
+    Node *_lhs{nullptr};
+    Node *_rhs{nullptr};
+    Type *_type{nullptr};
+    bool _exact{false};
 };
 
 
 class funcallNode final : public Node {
 public:
     funcallNode(const token &tk,
-                std::vector<std::shared_ptr<Node>>& args,
-                const SymbolInfo &info):
+                std::span<Node*> args,
+                const SymbolInfo *info):
                _tk(tk),
-               _args(std::move(args)),
+               _args(args),
                _info(info) {}
     funcallNode()=default;
     ~funcallNode()=default;
 
-    std::string getName()const { return _tk.str; }
-    const std::vector<std::shared_ptr<Node>> &getArgs()const { return _args; }
+    std::string getName()const { return std::string(_tk.str); }
+    std::span<Node*> getArgs()const { return _args; }
 
-    std::shared_ptr<Type> getType()const override { return _info._type; }
-    size_t typeSize()const override { return _info._type->getSize(); }
+    Type *getType()const override { return _info->_type; }
+    size_t typeSize()const override { return _info->_type->getSize(); }
     bool equal(Node::Kind kind)const override { return kind == Node::Kind::N_funcall; }
 
     size_t strLength()const override { return _tk.str.length(); }
     size_t strStart()const override{ return _tk.start; }
-    std::string strView()const override { return _tk.str; }
+    std::string strView()const override { return std::string(_tk.str); }
 
     void accept(visitor& vis) override{ vis.visit(*this); }
 private:
     token _tk;
-    std::vector<std::shared_ptr<Node>> _args;
-    SymbolInfo _info;
+    std::span<Node*> _args;
+    const SymbolInfo *_info{nullptr};
 };
 
 class Stmt {
@@ -278,66 +283,70 @@ private:
 
 class exprStmt final: public Stmt {
 public:
-    exprStmt(std::shared_ptr<Node>& expr):_e(std::move(expr)){}
+    exprStmt(Node *expr):_e(expr){}
     exprStmt()=default;
     ~exprStmt()=default;
 
     void accept(visitor& vis) override{ vis.visit(*this); }
 
-    const std::shared_ptr<Node>& getNode()const {  return _e;}
+    Node *getNode()const {  return _e;}
 private:
-    std::shared_ptr<Node> _e;
+    Node *_e{nullptr};
 };
 
 
 class blockStmt final: public Stmt{
 public:
-    blockStmt(std::vector<std::shared_ptr<Stmt>>& _stmts):stmts(std::move(_stmts)){}
+    blockStmt(std::span<Stmt*> _stmts):stmts(_stmts){}
     blockStmt()=default;
     ~blockStmt()=default;
     void accept(visitor& vis) override{ vis.visit(*this); }
     void compileStmts(visitor &vis)const { for(auto &s : stmts) s->accept(vis); }
 
 private:
-    std::vector<std::shared_ptr<Stmt>> stmts;
+    std::span<Stmt*> stmts;
 };
 
 class retStmt final : public Stmt {
 public:
     retStmt()=default;
     ~retStmt()=default;
-    retStmt(std::shared_ptr<Stmt> e):_e(e) {}
+    retStmt(Stmt *e):_e(e) {}
     void accept(visitor& vis) override{ vis.visit(*this); }
 
-    void compileStmt(visitor &vis)const { _e->accept(vis); }
+    bool compileStmt(visitor &vis)const {
+        if(_e) _e->accept(vis);
+        return _e != nullptr;
+    }
     static std::string getName() { return _funcname; }
     static void setFuncName(const std::string& name) { _funcname = name; }
 private:
-    std::shared_ptr<Stmt> _e;
+    Stmt *_e{nullptr};
     static inline std::string _funcname;
 };
 
 class whileStmt final : public Stmt {
 public:
-    whileStmt(std::shared_ptr<Node> cond,std::shared_ptr<Stmt> body):_cond(cond),_body(body) {}
+    whileStmt(Node *cond,Stmt *body):_cond(cond),_body(body) {}
     ~whileStmt()=default;
     void accept(visitor& vis) override{ vis.visit(*this); }
     void compileCond(visitor &vis) {
         if(_cond) _cond->accept(vis);
     }
+    Node *getCond()const { return _cond; }
     void compileBody(visitor &vis) {
         if(_body) _body->accept(vis);
     }
     
 private:
-    std::shared_ptr<Node> _cond;
-    std::shared_ptr<Stmt> _body;
+    Node *_cond{nullptr};
+    Stmt *_body{nullptr};
 };
 
 class forStmt final : public Stmt {
 public:
-    forStmt(std::shared_ptr<Stmt> init,std::shared_ptr<Stmt> cond,
-            std::shared_ptr<Node> inc,std::shared_ptr<Stmt> body):_init(init),_cond(cond),_inc(inc),_body(body) {}
+    forStmt(Stmt *init,Stmt *cond,
+            Node *inc,Stmt *body):_init(init),_cond(cond),_inc(inc),_body(body) {}
     ~forStmt()=default;
     void accept(visitor& vis) override{ vis.visit(*this); }
 
@@ -348,51 +357,55 @@ public:
          if(_cond) _cond->accept(vis); 
          return _cond != nullptr;
     }
+    // the condition is parsed as an expression statement, or is absent
+    Node *getCond()const {
+        return _cond ? static_cast<exprStmt*>(_cond)->getNode() : nullptr;
+    }
     
 private:
-    std::shared_ptr<Stmt> _init;
-    std::shared_ptr<Stmt> _cond;
-    std::shared_ptr<Node> _inc;
-    std::shared_ptr<Stmt> _body;
+    Stmt *_init{nullptr};
+    Stmt *_cond{nullptr};
+    Node *_inc{nullptr};
+    Stmt *_body{nullptr};
 };
 
 
 class ifStmt final: public Stmt{
 public:
-    ifStmt(std::shared_ptr<Node> &cond,
-           std::shared_ptr<Stmt>& then,
-           std::shared_ptr<Stmt>& elseNode):
-                    _cond(std::move(cond)),
-                    _then(std::move(then)),
-                    _elseNode(std::move(elseNode)) { }
+    ifStmt(Node *cond,
+           Stmt *then,
+           Stmt *elseNode):
+                    _cond(cond),
+                    _then(then),
+                    _elseNode(elseNode) { }
     ifStmt()=default;
     ~ifStmt()=default;
 
     void accept(visitor& vis) override{ vis.visit(*this); }
 
-    const std::shared_ptr<Node>& getCond()const { return _cond; }
-    const std::shared_ptr<Stmt>& getThen()const { return _then; }
-    const std::shared_ptr<Stmt>& getElse()const { return _elseNode; }
+    Node *getCond()const { return _cond; }
+    Stmt *getThen()const { return _then; }
+    Stmt *getElse()const { return _elseNode; }
 private:
-    std::shared_ptr<Node> _cond;
-    std::shared_ptr<Stmt> _then;
-    std::shared_ptr<Stmt> _elseNode;
+    Node *_cond{nullptr};
+    Stmt *_then{nullptr};
+    Stmt *_elseNode{nullptr};
 };
 
 
 class vardef final : public Stmt {
 public:
     vardef()=default;
-    vardef(std::vector<std::shared_ptr<Node>>& _decls,bool isglobal):
-           decls(std::move(_decls)),
+    vardef(std::span<Node*> _decls,bool isglobal):
+           decls(_decls),
            _isglobal(isglobal) {}
     ~vardef()=default;
 
     void accept(visitor& vis) override{ vis.visit(*this); }
     bool isGlobal() { return _isglobal; }
-    const std::vector<std::shared_ptr<Node>>& getDeclas()const { return decls; }
+    std::span<Node*> getDeclas()const { return decls; }
 private:
-    std::vector<std::shared_ptr<Node>> decls;
+    std::span<Node*> decls;
     bool _isglobal;
 };
 
@@ -401,13 +414,13 @@ private:
 class funcdef final : public Stmt {
 public:
     funcdef()=default;
-    funcdef( std::shared_ptr<Stmt>& _b,
+    funcdef( Stmt *_b,
              const std::string& _n,
-             std::vector<std::shared_ptr<Node>> &_params,
+             std::span<Node*> _params,
              int _stackoff):
-                    _body(std::move(_b)),
+                    _body(_b),
                     _name(_n),
-                    _params(std::move(_params)),
+                    _params(_params),
                     _stackoff(_stackoff) {}
 
     static int newlocalVar(int size) {
@@ -415,30 +428,37 @@ public:
         return -_stacksize;
     }
     static int getStaksize() { return _stacksize; }
-    static void stackrelease() { _stacksize = 0; }
+    static void stackrelease() { _stacksize = 0; _taken.clear(); }
+    // '&' applied to the local at 'offset' somewhere in the function being parsed
+    static void addressTaken(int offset) { _taken.insert(offset); }
 
     static int align(int align) { return (_stacksize + align -1) / align * align; }
     void accept(visitor& vis) override{ vis.visit(*this); }
 
-    static std::shared_ptr<Stmt> newFunction(
-                          std::shared_ptr<Stmt>& _b,
+    static Stmt *newFunction(
+                          arena& a,
+                          Stmt *_b,
                           const std::string& _n,
-                          std::vector<std::shared_ptr<Node>> &_params) {
-        std::shared_ptr<Stmt> func = std::make_shared<funcdef>(_b,_n,_params,align(16));
+                          std::span<Node*> _params) {
+        auto func = a.make<funcdef>(_b,_n,_params,align(16));
+        func->_addr_taken = std::move(_taken);
         stackrelease();
         return func;
     }
 
-    const std::shared_ptr<Stmt>& getBody()const { return _body; }
+    Stmt *getBody()const { return _body; }
     std::string getName()const { return _name;}
-    const std::vector<std::shared_ptr<Node>>& getParams()const { return _params; }
+    std::span<Node*> getParams()const { return _params; }
     int getStackOff() { return _stackoff; }
+    bool isAddressTaken(int offset)const { return _addr_taken.count(offset) != 0; }
 private:
-    std::shared_ptr<Stmt> _body;
+    Stmt *_body{nullptr};
     std::string _name;
-    std::vector<std::shared_ptr<Node>> _params;
+    std::span<Node*> _params;
     int _stackoff;
+    std::unordered_set<int> _addr_taken;
     static inline int _stacksize{0};
+    static inline std::unordered_set<int> _taken;
 };
 
 
@@ -446,8 +466,8 @@ class Prog {
 public:
     Prog()=default;
     ~Prog()=default;
-    Prog(std::vector<std::shared_ptr<Stmt>> &stmt):_stmts(std::move(stmt)){}
+    Prog(std::vector<Stmt*> &stmt):_stmts(std::move(stmt)){}
     void accept(visitor& vis){ vis.visit(*this); }
-    std::vector<std::shared_ptr<Stmt>> _stmts;
+    std::vector<Stmt*> _stmts;
 };
 #endif
\ No newline at end of file
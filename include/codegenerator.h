@@ -1,36 +1,60 @@
 #ifndef CODEGENERATOR_H_
 #define CODEGENERATOR_H_
 
-#include "visitor.h"
-#include "parse.h"
+#include "ir.h"
+#include "regalloc.h"
+#include "emitter.h"
 
-class codegenerator final: public visitor {
+#include <memory>
+
+/*
+ * x86-64 backend: turns the IR of each function into emitter records,
+ * with virtual registers mapped by the linear-scan allocator.
+ */
+class codegenerator final {
 public:
-    codegenerator(){}
-    virtual ~codegenerator(){}
+    explicit codegenerator(emitter& e,bool omitFp = false):emit(e),omitFramePointer(omitFp){}
+    ~codegenerator(){}
+
+    void gen(const irModule& m);
+private:
+    void genStrings(const irModule& m);
+    void gen(const irFunc& f);
+    void gen(const irBlock& b,size_t idx);
+    void gen(const irInst& in);
+    void genBinary(const irInst& in);
+    void genCompare(const irInst& in);
+    void genDiv(const irInst& in);
+    void moveArgs(const irInst& in);
+    void genCall(const irInst& in);
+    void genTailCall(const irInst& in);
+    void genLoad(const irInst& in);
+    void genStore(const irInst& in);
+    void genBlock(const irInst& in);
+    void genVector(const irInst& in);
+    void genBranch(const irBlock& b,size_t idx);
+    void epilogue();
+
+    operand loc(int vreg);
+    operand frame(int64_t off);
+    operand val(const irVal& v);
+    operand first(const irVal& v);
+    operand vec(const irVal& v,int width = 0);
+    operand mem(const irVal& addr);
+    operand target(int dst);
+    void mov(const operand& src,const operand& dst);
+    void writeBack(const operand& r,int dst);
+    int32_t blockLabel(size_t idx);
 
-    void visit(numericNode&)override;
-    void visit(stringNode&)override;
-    void visit(identNode&)override;
-    void visit(prefixNode&)override;
-    void visit(binaryNode&)override;
-    void visit(funcallNode&)override;
-    void visit(arrayVisit&)override;
-    void visit(arraydef&)override;
-    void visit(ifStmt&)override;
-    void visit(whileStmt&)override;
-    void visit(forStmt&)override;
-    void visit(exprStmt&)override;
-    void visit(blockStmt&)override;
-    void visit(retStmt&)override;
-    void visit(vardef&)override;
-    void visit(funcdef&)override;
-    void visit(Prog&)override;
+    emitter& emit;
+    const irModule *mod{nullptr};
+    const irFunc *func{nullptr};
+    std::unique_ptr<regalloc> ra;
+    int32_t retLabel{-1};
+    bool omitFramePointer;
+    bool tailCalls{false};
+    int adjust{0};      // how far %rsp is moved down when there is no %rbp
 
-    void push(std::string_view reg);
-    void pop(std::string_view reg);
-    void gen_addr(Node& ident);
-    void store(const Node& node);
-    void load(const Node& node);
+    static constexpr int redZone = 128;
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,21 @@
+#ifndef ELFWRITER_H_
+#define ELFWRITER_H_
+
+#include "assembler.h"
+
+#include <string>
+
+/*
+ * writes the output of the assembler as an ELF64 relocatable object:
+ * .text/.data/.rodata, their .rela sections, .symtab and the string tables.
+ */
+class elfwriter {
+public:
+    explicit elfwriter(const assembler& a):as(a){}
+
+    void build(std::string& buf)const;
+    bool write(const char *path)const;
+private:
+    const assembler& as;
+};
+#endif
@@ -0,0 +1,114 @@
+#ifndef EMITTER_H_
+#define EMITTER_H_
+
+#include "arena.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// numbered as in the x86-64 encoding
+enum class reg : uint8_t {
+    rax,rcx,rdx,rbx,rsp,rbp,rsi,rdi,
+    r8,r9,r10,r11,r12,r13,r14,r15,
+    rip,none,
+};
+
+enum class opcode : uint8_t {
+    // directives
+    label,globl,text,data,rodata,strings,string,ascii,zero,byte,quad,
+    // instructions
+    mov,movsbq,movzbq,lea,add,sub,imul,idiv,cqo,neg,cmp,shl,sar,
+    sete,setne,setl,setle,setg,setge,
+    jmp,je,jne,jl,jle,jg,jge,
+    call,ret,push,pop,
+    nop,
+    repmovsb,       // %rcx bytes from (%rsi) to (%rdi)
+    repstosb,       // %rcx copies of %al to (%rdi)
+    // SSE2
+    movq,movdqa,movdqu,paddb,paddq,psubb,psubq,pxor,
+    punpcklbw,punpcklwd,punpckldq,punpcklqdq,punpckhqdq,
+    // AVX2; where VEX takes two sources the destination is the first
+    vmovq,vmovdqa,vmovdqu,vpaddb,vpaddq,vpsubb,vpsubq,vpxor,vpunpckhqdq,
+    vpbroadcastb,vpbroadcastq,
+    vextracti128,   // the upper half
+    vzeroupper,
+};
+
+
+struct operand {
+    enum class Kind : uint8_t { O_none,O_reg,O_imm,O_mem,O_sym };
+
+    Kind kind{Kind::O_none};
+    reg base{reg::none};
+    reg index{reg::none};
+    uint8_t scale{1};
+    uint8_t size{8};   // width of a register operand in bytes, 16 and 32 for %xmm and %ymm
+    int32_t sym{-1};   // symbol id, for rip-relative memory and labels
+    int64_t val{0};    // immediate, displacement or a symbol's addend
+
+    static operand r(reg r,uint8_t size = 8) { operand o; o.kind = Kind::O_reg; o.base = r; o.size = size; return o; }
+    static operand vec(int n,uint8_t size) { return r(static_cast<reg>(n),size); }
+    static operand imm(int64_t v) { operand o; o.kind = Kind::O_imm; o.val = v; return o; }
+    static operand mem(reg base,int64_t disp = 0) { operand o; o.kind = Kind::O_mem; o.base = base; o.val = disp; return o; }
+    static operand rip(int32_t sym,int64_t disp = 0) { operand o = mem(reg::rip,disp); o.sym = sym; return o; }
+    static operand symbol(int32_t sym) { operand o; o.kind = Kind::O_sym; o.sym = sym; return o; }
+
+    bool isReg()const { return kind == Kind::O_reg; }
+    bool isReg(reg r)const { return kind == Kind::O_reg && base == r; }
+    bool isImm()const { return kind == Kind::O_imm; }
+    bool isMem()const { return kind == Kind::O_mem; }
+    bool isVec()const { return kind == Kind::O_reg && size >= 16; }
+    bool operator==(const operand&)const=default;
+};
+
+
+// operands are kept in AT&T order: source first, destination last
+struct inst {
+    opcode op;
+    operand a;
+    operand b;
+};
+
+
+/*
+ * collects the assembly of a translation unit as structured records.
+ * passes may inspect and rewrite the records before write() turns
+ * them into text with a single bulk write.
+ */
+class emitter {
+public:
+    emitter()=default;
+    emitter(const emitter&)=delete;
+    emitter& operator=(const emitter&)=delete;
+
+    void emit(opcode op) { _insts.push_back({op,{},{}}); }
+    void emit(opcode op,const operand& a) { _insts.push_back({op,a,{}}); }
+    void emit(opcode op,const operand& a,const operand& b) { _insts.push_back({op,a,b}); }
+
+    void label(std::string_view name) { emit(opcode::label,operand::symbol(intern(name))); }
+    void globl(std::string_view name) { emit(opcode::globl,operand::symbol(intern(name))); }
+    void string(std::string_view str) { emit(opcode::string,operand::symbol(intern(str))); }
+    void ascii(std::string_view str) { emit(opcode::ascii,operand::symbol(intern(str))); }
+
+    int32_t intern(std::string_view name);
+    std::string_view name(int32_t sym)const { return _syms[sym]; }
+
+    std::vector<inst>& insts() { return _insts; }
+    const std::vector<inst>& insts()const { return _insts; }
+    size_t size()const { return _insts.size(); }
+    void insert(size_t pos,const std::vector<inst>& code) { _insts.insert(_insts.begin() + pos,code.begin(),code.end()); }
+
+    void print(std::string& buf)const;
+    bool write(const char *path)const;
+private:
+    void print(std::string& buf,const operand& o)const;
+
+    std::vector<inst> _insts;
+    arena _names;
+    std::vector<std::string_view> _syms;
+    std::unordered_map<std::string_view,int32_t> _symids;
+};
+#endif
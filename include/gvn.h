@@ -0,0 +1,47 @@
+#ifndef GVN_H_
+#define GVN_H_
+
+#include "ir.h"
+#include "ssa.h"
+
+#include <unordered_map>
+#include <vector>
+
+/*
+ * value numbering over the dominator tree of a function in SSA form. a
+ * pure instruction computing what one in a dominating position already
+ * computed is replaced by that result. loads count as pure while memory
+ * stays the same: within a block up to the next store or call, and into
+ * a block whose only predecessor is its immediate dominator. a load right
+ * after a full-width store to its address reads the stored value.
+ */
+class gvn final {
+public:
+    gvn(irFunc& f,ssa& s):func(f),form(s){}
+
+    void run();
+private:
+    struct key {
+        irOp op;
+        irVal a;
+        irVal b;
+        uint8_t size;
+        int memory;             // the state of memory a load reads, 0 for the rest
+        bool operator==(const key&)const=default;
+    };
+    struct hash {
+        size_t operator()(const key& k)const;
+    };
+
+    void visit(int b);
+    irVal resolve(const irVal& v)const;
+
+    irFunc& func;
+    ssa& form;
+    std::unordered_map<key,irVal,hash> table;
+    std::vector<key> scope;     // entries made by the blocks being visited, innermost last
+    std::vector<irVal> replace; // the earlier value for each redundant vreg
+    std::vector<int> memoryOut; // memory state each block ends with
+    int memories{0};
+};
+#endif
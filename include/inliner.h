@@ -0,0 +1,37 @@
+#ifndef INLINER_H_
+#define INLINER_H_
+
+#include "ir.h"
+
+#include <vector>
+
+/*
+ * substitutes the body of small functions at their call sites. functions
+ * are handled callees first (the strongly connected components of the
+ * call graph in reverse topological order), so a callee is already in
+ * optimized SSA form when it gets copied. calls inside one component are
+ * recursive and stay calls.
+ *
+ * the copy gets fresh vregs, its locals move below the caller's frame,
+ * parameters become the argument values and each return a jump to the
+ * rest of the calling block, where a phi collects the result.
+ */
+class inliner final {
+public:
+    static constexpr int defaultLimit = 40;
+
+    inliner(irModule& m,int lim):mod(m),limit(lim){}
+
+    std::vector<int> bottomUp();
+    bool run(irFunc& f);
+private:
+    int callee(const irInst& in)const;
+    static size_t cost(const irFunc& f);
+    int expand(irFunc& f,int b,size_t i,const irFunc& g);
+
+    irModule& mod;
+    int limit;
+    std::vector<int> target;        // function defined under each symbol, or -1
+    std::vector<int> component;     // strongly connected component of each function
+};
+#endif
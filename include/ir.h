@@ -0,0 +1,185 @@
+#ifndef IR_H_
+#define IR_H_
+
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class irOp : uint8_t {
+    copy,       // dst = a
+    add,        // dst = a + b
+    sub,
+    mul,
+    div,
+    shl,        // dst = a << b
+    sar,        // dst = a >> b, arithmetic
+    neg,        // dst = -a
+    lt,         // dst = a < b
+    le,
+    gt,
+    ge,
+    eq,
+    ne,
+    addr,       // dst = address of the local or global a
+    load,       // dst = *a, 'size' bytes, sign-extended
+    store,      // *a = b, 'size' bytes
+    blkcopy,    // args[0] bytes at a = those at b
+    blkzero,    // args[0] bytes at a = 0
+    call,       // dst = sym(args...)
+    param,      // dst = incoming argument a
+    phi,        // dst = args[i] when entered from block incoming[i]
+    // on vector registers of irFunc::vectorWidth bytes, in lanes of 'size' bytes
+    vsplat,     // a = b in every lane
+    vmov,       // a = b
+    vload,      // a = *b
+    vstore,     // *a = b
+    vadd,       // a += b, lane by lane
+    vsub,       // a -= b
+    vsum,       // dst = the sum of a's lanes
+    // terminators
+    jmp,        // goto succs[0]
+    br,         // (a cond b) ? succs[0] : succs[1]
+    ret,        // return a
+};
+
+
+struct irVal {
+    enum class Kind : uint8_t { V_none,V_reg,V_imm,V_local,V_global,V_vec };
+
+    Kind kind{Kind::V_none};
+    int64_t v{0};   // vreg number, immediate, frame offset, symbol id or vector register
+
+    static irVal reg(int n) { return {Kind::V_reg,n}; }
+    static irVal imm(int64_t n) { return {Kind::V_imm,n}; }
+    static irVal local(int off) { return {Kind::V_local,off}; }
+    static irVal global(int sym) { return {Kind::V_global,sym}; }
+    static irVal vec(int n) { return {Kind::V_vec,n}; }
+
+    bool isNone()const { return kind == Kind::V_none; }
+    bool isReg()const { return kind == Kind::V_reg; }
+    bool isImm()const { return kind == Kind::V_imm; }
+    bool isAddr()const { return kind == Kind::V_local || kind == Kind::V_global; }
+    bool operator==(const irVal&)const=default;
+};
+
+
+struct irInst {
+    irInst(irOp o,int d = -1,const irVal& x = {},const irVal& y = {}):op(o),dst(d),a(x),b(y) {}
+
+    irOp op;
+    int dst{-1};            // vreg defined by the instruction, -1 for none
+    irVal a;
+    irVal b;
+    uint8_t size{8};        // access width of load/store, lane width of vector operations
+    irOp cond{irOp::ne};    // comparison a br tests, lt..ne
+    int32_t sym{-1};        // callee of a call
+    std::vector<irVal> args;
+    std::vector<int> incoming;  // predecessor each argument of a phi comes from
+
+    bool isTerminator()const { return op == irOp::jmp || op == irOp::br || op == irOp::ret; }
+    bool isVector()const { return op >= irOp::vsplat && op <= irOp::vsum; }
+    // stores, block moves and calls may change what any load reads
+    bool writesMemory()const {
+        return op == irOp::store || op == irOp::blkcopy || op == irOp::blkzero || op == irOp::call || op == irOp::vstore;
+    }
+    template<typename F> void forUses(F&& f)const {
+        if(a.isReg()) f(static_cast<int>(a.v));
+        if(b.isReg()) f(static_cast<int>(b.v));
+        for(auto &arg : args) if(arg.isReg()) f(static_cast<int>(arg.v));
+    }
+    template<typename F> void mapUses(F&& f) {
+        f(a);
+        f(b);
+        for(auto &arg : args) f(arg);
+    }
+};
+
+
+struct irBlock {
+    std::vector<irInst> insts;  // the last one is the terminator
+    std::vector<int> succs;
+    std::vector<int> preds;
+
+    const irInst& terminator()const { return insts.back(); }
+    bool isTailCall(size_t i)const;
+};
+
+
+struct irFunc {
+    std::string name;
+    std::vector<irBlock> blocks;  // in layout order, blocks[0] is the entry
+    int nparams{0};
+    int nregs{0};
+    int frame{0};                 // bytes of locals below %rbp
+    int vectorWidth{16};          // bytes in a vector register
+
+    int newReg() { return nregs++; }
+    void computePreds();
+    void renumber(const std::vector<int>& index);
+    void shrinkFrame();
+    bool addressesFrame()const;
+};
+
+
+// the outcome of 'a cc b' for one of the comparisons lt..ne
+bool irCompare(irOp cc,int64_t a,int64_t b);
+// the comparison that holds with the operands the other way round
+irOp irSwapped(irOp cc);
+
+
+// an initial value: the number v, or the address of symbol sym plus v
+struct irDatum {
+    int64_t v{0};
+    int32_t sym{-1};
+};
+
+
+struct irGlobal {
+    std::string name;
+    size_t size;
+    bool is_string;
+    std::string str;
+    bool readonly{false};           // in .rodata and local to the unit
+    uint8_t elem{8};                // bytes in each value of init
+    std::vector<irDatum> init{};    // the leading values, zeros follow up to size
+};
+
+
+struct irModule {
+    std::vector<irGlobal> globals;
+    std::vector<irFunc> funcs;
+    std::vector<std::string> syms;
+
+    int intern(std::string_view name);
+    std::string_view symName(int sym)const { return syms[sym]; }
+    void dump(std::string& buf)const;
+private:
+    std::unordered_map<std::string,int> _symids;
+};
+
+
+/*
+ * per-block liveness of virtual registers, computed by the usual
+ * backward dataflow iteration over the control-flow graph. a phi reads
+ * its arguments on the incoming edges, so they are live out of the
+ * predecessors rather than into the phi's block. the sets hold a bit
+ * per vreg, packed into words.
+ */
+struct irLiveness {
+    std::vector<std::vector<uint64_t>> in;
+    std::vector<std::vector<uint64_t>> out;
+
+    explicit irLiveness(const irFunc& f);
+
+    static bool has(const std::vector<uint64_t>& set,int r) { return set[r >> 6] >> (r & 63) & 1; }
+    template<typename F> static void each(const std::vector<uint64_t>& set,F fn) {
+        for(size_t w = 0; w < set.size(); w++) {
+            for(uint64_t bits = set[w]; bits; bits &= bits - 1)
+                fn(static_cast<int>(w * 64 + std::countr_zero(bits)));
+        }
+    }
+};
+#endif
@@ -0,0 +1,67 @@
+#ifndef IRGEN_H_
+#define IRGEN_H_
+
+#include "visitor.h"
+#include "parse.h"
+#include "ir.h"
+
+#include <unordered_map>
+
+/*
+ * lowers the AST into the three-address IR: expressions become
+ * instructions over virtual registers, statements become basic blocks.
+ */
+class irgenerator final: public visitor {
+public:
+    irgenerator(irModule& m):mod(m){}
+    virtual ~irgenerator(){}
+
+    void visit(numericNode&)override;
+    void visit(stringNode&)override;
+    void visit(identNode&)override;
+    void visit(prefixNode&)override;
+    void visit(binaryNode&)override;
+    void visit(funcallNode&)override;
+    void visit(arrayVisit&)override;
+    void visit(arraydef&)override;
+    void visit(ifStmt&)override;
+    void visit(whileStmt&)override;
+    void visit(forStmt&)override;
+    void visit(exprStmt&)override;
+    void visit(blockStmt&)override;
+    void visit(retStmt&)override;
+    void visit(vardef&)override;
+    void visit(funcdef&)override;
+    void visit(Prog&)override;
+private:
+    irVal lower(Node& node);
+    irVal location(Node& node);
+    irVal materialize(const irVal& v);
+    irVal load(const irVal& addr,size_t size);
+    void block(irOp op,const irVal& addr,int64_t n,const irVal& src = {});
+    irDatum datum(Node& init);
+    irVal op(irOp op,const irVal& a,const irVal& b = {});
+    irVal scale(const irVal& v,int64_t size);
+    int variable(int offset);
+
+    int newBlock();
+    void setBlock(int b);
+    bool terminated()const;
+    void append(irInst in);
+    void jump(int target);
+    void branch(const irVal& cond,int then,int other);
+    void condition(Node *cond,int then,int other);
+    void layout();
+
+    irModule& mod;
+    irFunc *func{nullptr};
+    const funcdef *fdef{nullptr};
+    int cur{0};
+    std::vector<int> order;
+    std::unordered_map<int,int> promoted;   // frame offset -> vreg of a variable kept in a register
+    irVal val;
+
+    // constant bytes in an array initializer worth a .rodata image of it
+    static constexpr int64_t imageBytes = 32;
+};
+#endif
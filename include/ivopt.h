@@ -0,0 +1,46 @@
+#ifndef IVOPT_H_
+#define IVOPT_H_
+
+#include "ir.h"
+#include "loops.h"
+#include "ssa.h"
+
+#include <vector>
+
+/*
+ * induction-variable strength reduction on SSA form. a basic induction
+ * variable is a header phi stepped by a constant on the one back edge;
+ * an address base + m*i + k computed from it in the loop becomes a
+ * pointer of its own, started in the preheader and bumped by m*step.
+ * when the counter is then only tested against an invariant bound, the
+ * test moves to the pointer (linear-function test replacement) and the
+ * counter dies.
+ */
+class ivopt final : loopvalues {
+public:
+    ivopt(irFunc& f,ssa& s):loopvalues(f),form(s){}
+
+    void run();
+private:
+    struct basic {
+        int phi;
+        int next;           // phi + step, the value on the back edge
+        irVal init;
+        int64_t step;
+    };
+    struct reduced {
+        int iv;
+        int ptr;            // the phi replacing base + m*iv + k
+        affine f;
+    };
+
+    void reduce(const irLoop& l);
+    void replaceTest(const reduced& r,const loopinfo& info);
+    bool pointsIntoObject(const reduced& r,int step)const;
+    irVal start(std::vector<irInst>& insts,const affine& f,const irVal& x);
+
+    ssa& form;
+    std::vector<basic> ivs;
+    std::vector<reduced> done;
+};
+#endif
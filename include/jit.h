@@ -0,0 +1,33 @@
+#ifndef JIT_H_
+#define JIT_H_
+
+#include "assembler.h"
+
+#include <string>
+
+/*
+ * runs an assembled program in-process: the sections are copied into an
+ * mmap'd region and relocated there. calls that leave the program go
+ * through stubs to a small set of C library functions. then main is called.
+ */
+class jit {
+public:
+    explicit jit(const assembler& a):as(a){}
+    jit(const jit&)=delete;
+    jit& operator=(const jit&)=delete;
+    ~jit();
+
+    bool load();
+    bool run(int& status);
+    const std::string& error()const { return _error; }
+private:
+    void *resolve(std::string_view name)const;
+
+    const assembler& as;
+    uint8_t *region{nullptr};
+    size_t length{0};
+    uint8_t *base[assembler::S_count]{};
+    std::vector<uint8_t*> addrs;    // runtime address of each symbol
+    std::string _error;
+};
+#endif
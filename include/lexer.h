@@ -1,9 +1,11 @@
 #ifndef LEXER_H_
 #define LEXER_H_
 
+#include <cstdint>
 #include <vector>
 #include <iostream>
 #include <format>
+#include <string_view>
 #include <unordered_map>
 #include <map>
 
@@ -43,37 +45,49 @@ enum class tokenType {
     T_return,
     T_int,
     T_char,
-    T_eof,
+    T_eof,          // last, it sizes the tables indexed by tokenType
 };
 
 #define is_alpha(c) ( (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') )
-#define is_identifier(c) (is_alpha(c) || c == '_')
 #define is_number(c) ( c >= '0' && c <= '9' )
-#define is_bracket(c) ( c == '(' || c == ')' || c == '[' || c == ']' || c == '{' || c == '}' )
-#define is_blank(c) (c == '\n' || c == '\t' || c == '\r' || c == ' ')
 #define is_eof(c) (c == '\0')
-#define is_semicolon(c) (c == ';')
 #define is_hex_num(c) ( (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') || is_number(c) )
-#define is_operator(c) ( c == '+' || c == '-' || c == '*' || c == '/' || c == '=' || c == '<' || c == '>' || c == '!') 
-#define is_puct(c) ( c == ';' || c == ',' || c == '.' || c == '&' )
-#define is_string(c) ( c == '"' )
+
+// what a character can start, which picks the scanner for the token
+enum class charClass : uint8_t {
+    C_other,
+    C_blank,
+    C_digit,
+    C_ident,
+    C_quote,
+    C_bracket,
+    C_operator,
+    C_puct,
+    C_eof,
+};
 
 
+/*
+ * a token refers into the source text, which outlives it. identifiers also
+ * carry the id their spelling is interned under, -1 for other tokens.
+ */
 struct token {
     token()=default;
-    token(int value,int st,const std::string& s,tokenType t): val(value), start(st), str(s), type(t){}
+    token(int value,int st,std::string_view s,tokenType t,int ident = -1): val(value), start(st), id(ident), type(t), str(s){}
     bool assert(tokenType ty)const { return type == ty;}
     int val;
     int start;
-    std::string str;
+    int id;
     tokenType type;
+    std::string_view str;
 };
 
 
 class lexer {
 public:
     lexer()=default;
-    lexer(std::string_view str):src(str) {}
+    // str must stay alive and be followed by a '\0'
+    lexer(std::string_view str):src(str),wide(hasAvx2()) {}
     token newToken();
 
     void advance();
@@ -88,14 +102,17 @@ public:
     token puct();
     token eof();
     token string();
-    bool iskeyword(const std::string& name);
+    bool iskeyword(std::string_view name);
 
-    void error_at(int start,int hintlen,std::string_view errmsg);
+    [[noreturn]] void error_at(int start,int hintlen,std::string_view errmsg);
 private:
     token scan();
+    static bool hasAvx2();
 
     size_t start{0};
     size_t cur{0};
-    std::string src;
+    std::string_view src;
+    bool wide{false};   // scan with 32-byte AVX2 blocks
+    std::unordered_map<std::string_view,int> ids;     // identifier spelling -> its id
 };
 #endif
\ No newline at end of file
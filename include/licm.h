@@ -0,0 +1,29 @@
+#ifndef LICM_H_
+#define LICM_H_
+
+#include "ir.h"
+#include "loops.h"
+#include "ssa.h"
+
+#include <vector>
+
+/*
+ * loop-invariant code motion on SSA form: an instruction whose operands
+ * are all defined outside a loop computes the same value on every trip and
+ * moves to the loop's preheader. loops are visited innermost first, so an
+ * invariant climbs out as far as it can.
+ */
+class licm final {
+public:
+    licm(irFunc& f,ssa& s):func(f),form(s){}
+
+    void run();
+private:
+    bool hoistable(const irInst& in,int b,const irLoop& l,bool memory,const std::vector<int>& exits)const;
+    void hoist(const irLoop& l);
+
+    irFunc& func;
+    ssa& form;
+    std::vector<int> defblock;  // block defining each vreg
+};
+#endif
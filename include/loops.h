@@ -0,0 +1,75 @@
+#ifndef LOOPS_H_
+#define LOOPS_H_
+
+#include "ir.h"
+#include "ssa.h"
+
+#include <vector>
+
+struct irLoop {
+    int header;
+    int preheader{-1};          // the only block outside the loop jumping to the header
+    std::vector<int> latches;   // blocks jumping back to the header
+    std::vector<bool> body;     // indexed by block
+    size_t size{0};
+
+    bool contains(int b)const { return body[b]; }
+};
+
+
+/*
+ * the natural loops of a function in SSA form: a back edge goes to a block
+ * dominating its source, and the loop is everything that reaches the back
+ * edge without passing the header. back edges to one header make one loop.
+ * every loop is given a preheader, and the list is innermost first.
+ */
+class loopinfo final {
+public:
+    loopinfo(irFunc& f,ssa& s):func(f),form(s){}
+
+    void analyze();
+    const std::vector<irLoop>& loops()const { return _loops; }
+private:
+    void find();
+    void addPreheader(const irLoop& l);
+
+    irFunc& func;
+    ssa& form;
+    std::vector<irLoop> _loops;
+};
+
+
+// wrapping arithmetic, as the generated code does it
+int64_t wrapAdd(int64_t a,int64_t b);
+int64_t wrapMul(int64_t a,int64_t b);
+
+
+// base + m*iv + k, a value stepping along with the counter iv
+struct affine {
+    int iv{-1};         // the counter, -1 if the value does not follow one
+    int64_t m{0};
+    irVal base;         // invariant register added, if any
+    int64_t k{0};
+    bool operator==(const affine&)const=default;
+};
+
+
+/*
+ * what the passes rewriting loops share: where each vreg is defined, what
+ * a loop leaves unchanged, how the values it computes follow its counters,
+ * and arithmetic emitted ahead of or into it.
+ */
+class loopvalues {
+public:
+    loopvalues(irFunc& f):func(f){}
+protected:
+    void locate();
+    bool invariant(const irVal& v,const irLoop& l)const;
+    affine follow(const irInst& in,affine fa,affine fb,const irLoop& l)const;
+    irVal emit(std::vector<irInst>& insts,irOp op,const irVal& a,const irVal& b);
+
+    irFunc& func;
+    std::vector<int> defblock;          // the block defining each vreg, -1 for none
+    std::vector<const irInst*> defs;    // the instruction defining each vreg
+};
+#endif
@@ -10,10 +10,11 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <unordered_set>
-#include <memory>
 #include <functional>
 #include <format>
+#include <optional>
 #include <vector>
 #include <array>
 
@@ -29,55 +30,74 @@ enum class precType {
     P_prefix, /* -1,-2,'-' as prefix*/
 };
 
+// a value known when compiling: the number v, or the address of sym plus v
+struct constValue {
+    std::string sym;
+    int64_t v{0};
+};
+std::optional<constValue> evaluate(Node& node);
+
+
 class Parser {
 public:
     Parser(const char *src);
     ~Parser()=default;
+    // the program refers into the parser's arena, so the parser must outlive it
     Prog start();
-    using prefixcall = std::function<std::shared_ptr<Node>()>;
-    using infixcall = std::function<std::shared_ptr<Node>(std::shared_ptr<Node>& )>;
+    using prefixcall = Node *(Parser::*)();
+    using infixcall = Node *(Parser::*)(Node *lhs);
 private:
-    void setup();
+    // a row of the Pratt table: how the token starts an expression, how it
+    // continues one and how tightly it binds as an operator
+    struct rule {
+        prefixcall prefix{nullptr};
+        infixcall infix{nullptr};
+        precType prec{precType::P_none};
+    };
+    using ruleTable = std::array<rule,static_cast<size_t>(tokenType::T_eof) + 1>;
+    static const ruleTable rules;   // indexed by tokenType
 private:
-    std::shared_ptr<Node> parse_numeric();
-    std::shared_ptr<Node> parse_ident();
-    std::shared_ptr<Node> parse_string();
-    std::shared_ptr<Node> parse_prefix();
-    std::shared_ptr<Node> parse_binary_expr(std::shared_ptr<Node> lhs);
-    std::shared_ptr<Node> ptr_add(token& op,std::shared_ptr<Node> lhs,std::shared_ptr<Node> rhs);
-    std::shared_ptr<Node> ptr_sub(token& op,std::shared_ptr<Node> lhs,std::shared_ptr<Node> rhs);
-    std::shared_ptr<Node> parse_group_expr();
-    std::shared_ptr<Node> parse_expr(precType);
+    Node *parse_numeric();
+    Node *parse_ident();
+    Node *parse_string();
+    Node *parse_prefix();
+    Node *parse_binary_expr(Node *lhs);
+    Node *ptr_add(token& op,Node *lhs,Node *rhs);
+    Node *ptr_sub(token& op,Node *lhs,Node *rhs);
+    Node *fold(const token& op,Node *lhs,Node *rhs,Type *type);
+    Node *parse_group_expr();
+    Node *parse_expr(precType);
 
-    std::shared_ptr<Stmt> parse_stmt();
-    std::shared_ptr<Stmt> ret_stmt();
-    std::shared_ptr<Stmt> block_stmt();
-    std::shared_ptr<Stmt> for_stmt();
-    std::shared_ptr<Stmt> init_stmt();
-    std::shared_ptr<Stmt> if_stmt();
-    std::shared_ptr<Stmt> while_stmt();
-    std::shared_ptr<Stmt> expr_stmt();
+    Stmt *parse_stmt();
+    Stmt *ret_stmt();
+    Stmt *block_stmt();
+    Stmt *for_stmt();
+    Stmt *init_stmt();
+    Stmt *if_stmt();
+    Stmt *while_stmt();
+    Stmt *expr_stmt();
     
-    std::shared_ptr<Stmt> local_vars();
-    std::shared_ptr<Stmt> global_vars(std::shared_ptr<Type> type);
-    std::shared_ptr<Stmt> decl_func(std::shared_ptr<Type> retType);
-    std::vector<std::shared_ptr<Node>> funcParams(const token& tok,std::shared_ptr<Type> retType);
-    std::shared_ptr<Node> funcall();
-    std::shared_ptr<Node> identifier();
-    std::shared_ptr<Node> arrayvisit();
+    Stmt *local_vars();
+    Stmt *global_vars(Type *type);
+    Stmt *decl_func(Type *retType);
+    std::vector<Node*> funcParams(const token& tok,Type *retType);
+    Node *funcall();
+    Node *identifier();
+    Node *arrayvisit();
 
-    std::shared_ptr<Node> var_init(const SymbolInfo& info);
-    std::shared_ptr<Node> array_init(const SymbolInfo& info);
+    Node *var_init(const SymbolInfo *info);
+    Node *array_init(const SymbolInfo *info);
+    void constantInit(Node& init);
 private:
 
-    std::shared_ptr<Type> declType();
-    std::shared_ptr<Type> declspec();
-    std::shared_ptr<Type> pointerPrefix(std::shared_ptr<Type> base);
-    SymbolInfo varTypeSuffix(std::shared_ptr<Type> type,bool global);
+    Type *declType();
+    Type *declspec();
+    Type *pointerPrefix(Type *base);
+    const SymbolInfo *varTypeSuffix(Type *type,bool global);
     
     void error(const token& t,std::string_view msg);
     void error(int start,int hint_len,std::string_view msg);
-    void keywordCheck(const token& tok,const std::string& name);
+    void keywordCheck(const token& tok,std::string_view name);
 
     void tkskip(tokenType expected,const std::string& msg);
     bool tkequal(tokenType expect);
@@ -92,14 +112,15 @@ private:
     bool is_array();
     bool is_function();
 private:
+    arena nodes;            // the AST and its symbols
     lexer lex;
     SymbolTable sTable;
     int prev{-1};
     int cur{-1};
-    std::vector<token> tokens;
+    int lexed{0};
+    std::array<token,4> tokens;     // the last tokens read, enough to step back one
+    std::unordered_map<std::string_view,int> strings;   // literal -> its label in the string pool
 
-    std::map<tokenType, std::function<std::shared_ptr<Node>()>> prefixcalls;
-    std::map<tokenType, std::function<std::shared_ptr<Node>(std::shared_ptr<Node>& )>> infixcalls;
     infixcall get_infix_call(tokenType t);
     prefixcall get_prefix_call(tokenType t);
 };
@@ -0,0 +1,35 @@
+#ifndef PEEPHOLE_H_
+#define PEEPHOLE_H_
+
+#include "emitter.h"
+
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+/*
+ * peephole optimizer over the emitter records of each function. every
+ * entry of the pattern table looks at a short window of instructions and
+ * rewrites it in place; the table is applied until nothing matches.
+ * rewrites that drop a register write ask a small liveness walk that
+ * follows jumps within the function whether the value is still needed.
+ */
+class peephole {
+public:
+    explicit peephole(emitter& e):emit(e){}
+
+    void run();
+    void report(std::ostream& os)const;
+
+    struct stat {
+        std::string_view func;
+        std::vector<int> counts;   // rewrites per pattern of the table
+    };
+    const std::vector<stat>& stats()const { return _stats; }
+private:
+    void run(std::vector<inst>& code,stat& st);
+
+    emitter& emit;
+    std::vector<stat> _stats;
+};
+#endif
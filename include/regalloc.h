@@ -0,0 +1,60 @@
+#ifndef REGALLOC_H_
+#define REGALLOC_H_
+
+#include "emitter.h"
+#include "ir.h"
+
+#include <vector>
+#include <array>
+
+/*
+ * linear-scan register allocation (Poletto & Sarkar) over the virtual
+ * registers of one function. a live interval spans from the first to the
+ * last position its register is live at; an interval live across an
+ * instruction that clobbers physical registers (calls, division, long
+ * block moves, incoming parameters) may not be assigned those. when no
+ * register fits, the interval ending furthest away is spilled to a
+ * %rbp-relative slot.
+ * %rax and %r11 are never allocated, the code generator uses them as scratch.
+ */
+class regalloc {
+public:
+    static constexpr std::array<reg,12> pool{
+        reg::r10,reg::rsi,reg::rdi,reg::r8,reg::r9,reg::rcx,reg::rdx,
+        reg::rbx,reg::r12,reg::r13,reg::r14,reg::r15,
+    };
+    static constexpr std::array<reg,6> argregs{ reg::rdi,reg::rsi,reg::rdx,reg::rcx,reg::r8,reg::r9 };
+    // block moves this long go through rep movsb/stosb and take %rdi, %rsi and %rcx
+    static constexpr int64_t stringBytes = 256;
+
+    explicit regalloc(const irFunc& f);
+
+    operand loc(int vreg)const;
+    bool inReg(int vreg)const { return _regs[vreg] != reg::none; }
+
+    int frameSize()const;
+    const std::vector<reg>& calleeSaved()const { return _saved; }
+    int saveOffset(size_t i)const { return -(_frame_base + 8 * static_cast<int>(_nspills + i + 1)); }
+private:
+    struct interval {
+        int vreg;
+        int start;
+        int end;
+        uint32_t forbid;
+        reg hint;       // preferred register, the incoming one of a parameter
+    };
+    static uint32_t bit(reg r) { return 1u << static_cast<int>(r); }
+    static bool isCalleeSaved(reg r);
+
+    void buildIntervals(const irFunc& f);
+    void scan();
+    void spill(int vreg);
+
+    int _frame_base;
+    int _nspills{0};
+    std::vector<interval> _intervals;
+    std::vector<reg> _regs;
+    std::vector<int> _slots;
+    std::vector<reg> _saved;
+};
+#endif
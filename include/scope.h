@@ -5,12 +5,12 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
-#include <optional>
+#include "arena.h"
 #include "type.h"
 
 enum class SymbolType { S_var,S_array,S_func };
 struct SymbolInfo{
-    SymbolInfo(const token& tok,int offset,bool isglobal,const std::shared_ptr<Type> &type,SymbolType sty):
+    SymbolInfo(const token& tok,int offset,bool isglobal,Type *type,SymbolType sty):
                _tok(tok),
                _offset(offset),
                _isglobal(isglobal),
@@ -19,7 +19,7 @@ struct SymbolInfo{
     token _tok;
     int _offset;
     bool _isglobal;
-    std::shared_ptr<Type> _type;
+    Type *_type;
     SymbolType _sTy;
 };
 
@@ -29,50 +29,53 @@ class Scope {
 public:
     Scope()=default;
     ~Scope()=default;
-    void insert(const std::string& name,const SymbolInfo& info) {
-        _symbols.emplace(name,info);
+    void insert(int id,const SymbolInfo *info) {
+        _symbols.emplace(id,info);
     }
 
-    std::optional<SymbolInfo> lookup(const std::string& name) {
-        if(auto it = _symbols.find(name); it != _symbols.end()) {
+    const SymbolInfo *lookup(int id) {
+        if(auto it = _symbols.find(id); it != _symbols.end()) {
             return it->second;
         }
-        return std::nullopt;
+        return nullptr;
     }
 private:
-    std::unordered_map<std::string,SymbolInfo> _symbols;
+    std::unordered_map<int,const SymbolInfo*> _symbols;    // identifier id -> symbol
 };
 
 
+// symbols are made in the arena of the unit being parsed, which the AST refers into
 class SymbolTable{
 public:
+    SymbolTable(arena& a):_arena(a) {}
     void enter(){ _locals.push_back({}); }
     void leave(){ _locals.pop_back(); }
-    bool addSymbol(bool global,const std::string& name,const SymbolInfo& info) {
-        if(!reDefined(global,name)) {
-            if(global) _globals.insert(name,info);
-            else _locals.back().insert(name,info);
+    bool addSymbol(bool global,int id,const SymbolInfo *info) {
+        if(!reDefined(global,id)) {
+            if(global) _globals.insert(id,info);
+            else _locals.back().insert(id,info);
             return true;
         }
         return false;
     }
-    std::optional<SymbolInfo> lookup(const std::string& name) {
+    const SymbolInfo *lookup(int id) {
         for(auto p = _locals.rbegin(); p != _locals.rend(); ++p) {
-            if(auto it = p->lookup(name); it.has_value()) {
+            if(auto it = p->lookup(id)) {
                 return it;
             }
         }
-        auto p = _globals.lookup(name);
+        auto p = _globals.lookup(id);
         return p;
     }
-    static SymbolInfo newSymbol(const token& tok,int offset,bool isglobal,const std::shared_ptr<Type> &type,SymbolType sty) {
-        return SymbolInfo(tok,offset,isglobal,type,sty);
+    const SymbolInfo *newSymbol(const token& tok,int offset,bool isglobal,Type *type,SymbolType sty) {
+        return _arena.make<SymbolInfo>(tok,offset,isglobal,type,sty);
     }
 private:
-    bool reDefined(bool global,const std::string& name) {
-        if(global) return _globals.lookup(name).has_value();
-        else return _locals[_locals.size()-1].lookup(name).has_value();
+    bool reDefined(bool global,int id) {
+        if(global) return _globals.lookup(id) != nullptr;
+        else return _locals[_locals.size()-1].lookup(id) != nullptr;
     }
+    arena& _arena;
     std::vector<Scope> _locals;
     Scope _globals;
 };
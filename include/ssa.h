@@ -0,0 +1,50 @@
+#ifndef SSA_H_
+#define SSA_H_
+
+#include "ir.h"
+
+#include <vector>
+
+/*
+ * SSA form over the virtual registers of one function. construction is
+ * the usual one (Cytron et al.): phis at the iterated dominance frontier
+ * of the definitions, pruned by liveness, then renaming along the
+ * dominator tree. locals whose address is never taken are already vregs,
+ * so they are what the phis end up merging.
+ *
+ * destruction inserts a copy per phi argument and per phi result
+ * (Sreedhar's method I) and coalesces every copy whose two sides do not
+ * interfere, so only the copies that are really needed remain.
+ */
+class ssa final {
+public:
+    explicit ssa(irFunc& f):func(f){}
+
+    void construct();
+    void eliminateDeadCode();
+    void destruct();
+
+    void computeDominators();
+    bool dominates(int a,int b)const;
+    const std::vector<int>& idom()const { return _idom; }
+    const std::vector<int>& rpo()const { return _rpo; }
+    const std::vector<int>& dominated(int b)const { return children[b]; }
+private:
+    void simplifyCFG();
+    bool foldBranches();
+    bool removeUnreachable();
+    bool mergeBlocks();
+    bool propagateCopies();
+    void computeOrder();
+    void insertPhis();
+    void rename(int b,std::vector<std::vector<int>>& stacks);
+    void splitCriticalEdges();
+
+    irFunc& func;
+    std::vector<int> _rpo;                  // reachable blocks in reverse postorder
+    std::vector<int> _idom;                 // immediate dominator, the entry its own
+    std::vector<std::vector<int>> children; // dominator tree
+    std::vector<int> pre,last;              // dominator tree preorder, and the end of each subtree
+    std::vector<bool> renamed;              // vregs defined more than once or by a phi
+};
+#endif
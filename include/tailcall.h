@@ -0,0 +1,21 @@
+#ifndef TAILCALL_H_
+#define TAILCALL_H_
+
+#include "ir.h"
+
+/*
+ * a function returning the result of calling itself starts over instead:
+ * the arguments become the new parameter values and the call a jump back
+ * to just after the parameters are read. runs before SSA construction,
+ * which turns the reassigned parameters into phis. other tail calls are
+ * left to the code generator, which turns them into jumps.
+ */
+class tailcall final {
+public:
+    explicit tailcall(irModule& m):mod(m){}
+
+    bool run(irFunc& f);
+private:
+    irModule& mod;
+};
+#endif
@@ -4,7 +4,7 @@
 #include <iostream>
 #include <vector>
 #include <map>
-#include <memory>
+#include "arena.h"
 #include "lexer.h"
 class Type {
 public:
@@ -16,12 +16,14 @@ public:
     virtual size_t getSize()const=0;
     virtual std::string typestr()const=0;
 
-    static bool isPointer(std::shared_ptr<Type> type);
-    static bool isInteger(std::shared_ptr<Type> type);
-    static bool isArray(std::shared_ptr<Type> type);
-    static bool arePtrCompatible(const std::shared_ptr<Type>& lhs,const std::shared_ptr<Type>& rhs); 
+    static bool isPointer(Type *type);
+    static bool isInteger(Type *type);
+    static bool isArray(Type *type);
+    static bool arePtrCompatible(Type *lhs,Type *rhs); 
 private:
     Kind _kind;
+    Type *_pointer{nullptr};    // the pointer to this type, once made
+    friend class typeFactor;
 };
 
 
@@ -41,26 +43,26 @@ private:
 
 class pointerType final: public Type {
 public:
-    pointerType(std::shared_ptr<Type> base):Type(Type::Kind::T_ptr),_base(std::move(base)){}
+    pointerType(Type *base):Type(Type::Kind::T_ptr),_base(base){}
     size_t getSize()const override { return sizeof(void *); }
     size_t baseTypeSize()const { return _base->getSize(); }
     std::string typestr()const override { return _base->typestr() + " *"; }
     
-    std::shared_ptr<Type> getBaseType()const { return _base;}
+    Type *getBaseType()const { return _base;}
 private:
-    std::shared_ptr<Type> _base;
+    Type *_base;
 };
 
 
 class arrayType final : public Type{
 public:
-    arrayType(size_t len,std::shared_ptr<Type> type):
+    arrayType(size_t len,Type *type):
               Type(Type::Kind::T_array),
               _len(len),
               _elemTy(type){}
     ~arrayType()=default;
 
-    std::shared_ptr<Type> elemTy()const { return _elemTy; }
+    Type *elemTy()const { return _elemTy; }
     size_t elemSize()const { return _elemTy->getSize(); }
     size_t getSize()const override { return _len * _elemTy->getSize(); }
     size_t getlen() { return _len; }
@@ -68,20 +70,20 @@ public:
     std::string typestr()const override { return std::format("{}[{}]",_elemTy->typestr(),_len); }
 private:
     int _len;
-    std::shared_ptr<Type> _elemTy;
+    Type *_elemTy;
 };
 
 
 class funcType final: public Type {
 public:
-    funcType(std::shared_ptr<Type> ret,std::vector<std::shared_ptr<Type>> &param):
+    funcType(Type *ret,std::vector<Type*> &param):
         Type(Type::Kind::T_func),
         _retType(ret),
         _paramTypes(std::move(param)){}
 
     size_t getSize()const override { return 0; }
-    std::shared_ptr<Type> getRetType() { return _retType; }
-    const std::vector<std::shared_ptr<Type>> &getParamTypes()const { return _paramTypes; }
+    Type *getRetType() { return _retType; }
+    const std::vector<Type*> &getParamTypes()const { return _paramTypes; }
 
     std::string typestr()const override {
         std::string param_type_s{"("};
@@ -94,71 +96,84 @@ public:
         return std::format("{} {}",_retType->typestr(),param_type_s);
     }
 private:
-    std::shared_ptr<Type> _retType;
-    std::vector<std::shared_ptr<Type>> _paramTypes;
+    Type *_retType;
+    std::vector<Type*> _paramTypes;
 };
 
 
 
+/*
+ * types live as long as the program: int and char are single objects,
+ * each type has at most one pointer type to it, and the rest are made
+ * in an arena of their own.
+ */
 class typeFactor {
 public:
-    static std::shared_ptr<Type> getInt() {
-        return std::make_shared<baseType>(8,Type::Kind::T_int);
+    static Type *getInt() {
+        static baseType ty(8,Type::Kind::T_int);
+        return &ty;
     }
-    static std::shared_ptr<Type> getChar() {
-        return std::make_shared<baseType>(1,Type::Kind::T_char);
+    static Type *getChar() {
+        static baseType ty(1,Type::Kind::T_char);
+        return &ty;
     }
-    static std::shared_ptr<Type> getPointerType(std::shared_ptr<Type> base) {
-        return std::make_shared<pointerType>(base);
+    static Type *getPointerType(Type *base) {
+        if(!base->_pointer) base->_pointer = types().make<pointerType>(base);
+        return base->_pointer;
     }
 
-    static std::shared_ptr<Type> getArrayType(int len,std::shared_ptr<Type> datatype) {
-        return std::make_shared<arrayType>(len,datatype);
+    static Type *getArrayType(int len,Type *datatype) {
+        return types().make<arrayType>(len,datatype);
     }
 
-    static std::shared_ptr<Type> getFuncType(
-            std::shared_ptr<Type> ret,
-            std::vector<std::shared_ptr<Type>> &params) {
-                return std::make_shared<funcType>(ret,params);
+    static Type *getFuncType(
+            Type *ret,
+            std::vector<Type*> &params) {
+                return types().make<funcType>(ret,params);
+    }
+private:
+    static arena& types() {
+        static arena a;
+        return a;
     }
 };
 
 class typeChecker {
 public:
-    static std::shared_ptr<Type> checkEqual(const std::shared_ptr<Type>& lhs,const std::shared_ptr<Type>& rhs);
-    static std::shared_ptr<Type> checkBinaryOp( tokenType op, const std::shared_ptr<Type>& lhs, const std::shared_ptr<Type>& rhs);
+    static Type *checkEqual(Type *lhs,Type *rhs);
+    static Type *checkBinaryOp( tokenType op, Type *lhs, Type *rhs);
 private:
-    static bool isPointer(const std::shared_ptr<Type>& type) {
+    static bool isPointer(Type *type) {
         return type && type->getKind() == Type::Kind::T_ptr;
     }
-    static bool isInteger(const std::shared_ptr<Type>& type) {
+    static bool isInteger(Type *type) {
         return type && type->getKind() == Type::Kind::T_int;
     }
-    static std::shared_ptr<Type> decayArrayToPointer(const std::shared_ptr<Type>& type);
+    static Type *decayArrayToPointer(Type *type);
 };
 
 
 class pointerTypeCheck {
 public:
-    static std::shared_ptr<Type> checkBinaryOp(
+    static Type *checkBinaryOp(
         tokenType op,
-        const std::shared_ptr<Type>& lhs,
-        const std::shared_ptr<Type>& rhs);
+        Type *lhs,
+        Type *rhs);
     
-    static std::shared_ptr<Type> checkAddtion(
-        const std::shared_ptr<Type>& lhs,
-        const std::shared_ptr<Type>& rhs);
+    static Type *checkAddtion(
+        Type *lhs,
+        Type *rhs);
 
-    static std::shared_ptr<Type> checkSubtraction(
-        const std::shared_ptr<Type>& lhs,
-        const std::shared_ptr<Type>& rhs);
+    static Type *checkSubtraction(
+        Type *lhs,
+        Type *rhs);
 };
 
 class integerTypeCheck {
 public:
-    static std::shared_ptr<Type> checkBinaryOp(
-        const std::shared_ptr<Type>& lhs,
-        const std::shared_ptr<Type>& rhs){
+    static Type *checkBinaryOp(
+        Type *lhs,
+        Type *rhs){
             return lhs->getSize() > rhs->getSize() ? lhs : rhs;
         }
 };
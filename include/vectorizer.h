@@ -0,0 +1,44 @@
+#ifndef VECTORIZER_H_
+#define VECTORIZER_H_
+
+#include "ir.h"
+#include "loops.h"
+#include "ssa.h"
+
+#include <vector>
+
+/*
+ * vectorizes counted loops of a single block: a counter stepping by one up
+ * to an invariant bound, unit-stride loads and stores of ints or chars,
+ * lane-wise + and - between them, and sums of ints into a scalar. a vector
+ * loop in front runs whole vectors and hands the counter and the partial
+ * sums to the original loop, which finishes the remainder.
+ *
+ * accesses to the same array must not depend on each other within a
+ * vector's reach. where the arrays are not known to differ, the preheader
+ * compares the addresses and keeps to the scalar loop when they are close.
+ */
+class vectorizer final : loopvalues {
+public:
+    vectorizer(irFunc& f,ssa& s,int width):loopvalues(f),form(s),width(width){}
+
+    void run();
+private:
+    struct access {
+        affine f;
+        bool store;
+    };
+    struct pair {
+        const access *x;
+        const access *y;
+    };
+
+    bool vectorize(const irLoop& l);
+    bool independent(const access& x,const access& y,std::vector<pair>& checks)const;
+
+    ssa& form;
+    int width;                  // bytes in a vector register
+    int lanes{0};               // of the loop being vectorized
+    std::vector<int> done;      // counters of loops already vectorized
+};
+#endif
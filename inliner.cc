@@ -0,0 +1,158 @@
+#include "include/inliner.h"
+
+#include <algorithm>
+#include <functional>
+
+
+int inliner::callee(const irInst& in)const {
+    if(in.op != irOp::call || in.sym >= static_cast<int>(target.size())) return -1;
+    return target[in.sym];
+}
+
+
+// Tarjan's algorithm, which completes a component only after everything it calls
+std::vector<int> inliner::bottomUp() {
+    size_t n = mod.funcs.size();
+    target.assign(mod.syms.size(),-1);
+    for(size_t i = 0; i < n; i++) {
+        int sym = mod.intern(mod.funcs[i].name);
+        if(sym >= static_cast<int>(target.size())) target.resize(sym + 1,-1);
+        target[sym] = i;
+    }
+
+    std::vector<int> order,stack,index(n,-1),low(n);
+    std::vector<bool> onstack(n);
+    component.assign(n,-1);
+    int counter = 0,ncomponents = 0;
+    std::function<void(int)> visit = [&](int v) {
+        index[v] = low[v] = counter++;
+        stack.push_back(v);
+        onstack[v] = true;
+        for(auto &b : mod.funcs[v].blocks) {
+            for(auto &in : b.insts) {
+                int w = callee(in);
+                if(w < 0) continue;
+                if(index[w] < 0) {
+                    visit(w);
+                    low[v] = std::min(low[v],low[w]);
+                }else if(onstack[w]) {
+                    low[v] = std::min(low[v],index[w]);
+                }
+            }
+        }
+        if(low[v] != index[v]) return;
+        int w;
+        do {
+            w = stack.back();
+            stack.pop_back();
+            onstack[w] = false;
+            component[w] = ncomponents;
+            order.push_back(w);
+        }while(w != v);
+        ncomponents++;
+    };
+    for(size_t i = 0; i < n; i++) {
+        if(index[i] < 0) visit(i);
+    }
+    return order;
+}
+
+
+// the instructions the body would add at a call site
+size_t inliner::cost(const irFunc& f) {
+    size_t n = 0;
+    for(auto &b : f.blocks) {
+        for(auto &in : b.insts) {
+            if(in.op != irOp::phi && in.op != irOp::jmp) n++;
+        }
+    }
+    return n;
+}
+
+
+/*
+ * replaces the call at blocks[b].insts[i] by a copy of g. the calling
+ * block ends in a jump to g's entry and the instructions after the call
+ * move to a continuation block. returns the continuation's index, the
+ * blocks in between being g's.
+ */
+int inliner::expand(irFunc& f,int b,size_t i,const irFunc& g) {
+    auto &blocks = f.blocks;
+    int base = f.nregs,below = f.frame;
+    f.nregs += g.nregs;
+    f.frame += (g.frame + 7) / 8 * 8;
+    int first = blocks.size(),cont = first + g.blocks.size();
+
+    irBlock rest;
+    irInst call = std::move(blocks[b].insts[i]);
+    rest.insts.assign(std::make_move_iterator(blocks[b].insts.begin() + i + 1),std::make_move_iterator(blocks[b].insts.end()));
+    rest.succs = std::move(blocks[b].succs);
+    blocks[b].insts.erase(blocks[b].insts.begin() + i,blocks[b].insts.end());
+    blocks[b].insts.push_back({irOp::jmp});
+    blocks[b].succs = {first};
+    for(int s : rest.succs) {
+        for(auto &in : blocks[s].insts) {
+            if(in.op != irOp::phi) break;
+            for(int &from : in.incoming) {
+                if(from == b) from = cont;
+            }
+        }
+    }
+
+    irInst result{irOp::phi,call.dst};
+    for(size_t k = 0; k < g.blocks.size(); k++) {
+        irBlock nb = g.blocks[k];
+        for(int &s : nb.succs) s += first;
+        for(auto &in : nb.insts) {
+            if(in.dst >= 0) in.dst += base;
+            in.mapUses([&](irVal& v) {
+                if(v.isReg()) v.v += base;
+                else if(v.kind == irVal::Kind::V_local) v.v -= below;
+            });
+            for(int &from : in.incoming) from += first;
+            if(in.op == irOp::param) {
+                size_t n = in.a.v;
+                in = irInst(irOp::copy,in.dst,n < call.args.size() ? call.args[n] : irVal::imm(0));
+            }else if(in.op == irOp::ret) {
+                result.args.push_back(in.a.isNone() ? irVal::imm(0) : in.a);
+                result.incoming.push_back(first + k);
+                in = irInst(irOp::jmp);
+                nb.succs = {cont};
+            }
+        }
+        blocks.push_back(std::move(nb));
+    }
+    // a callee that never returns leaves the result undefined
+    if(result.args.size() < 2) {
+        irVal v = result.args.empty() ? irVal::imm(0) : result.args[0];
+        result = irInst(irOp::copy,call.dst,v);
+    }
+    rest.insts.insert(rest.insts.begin(),std::move(result));
+    blocks.push_back(std::move(rest));
+
+    std::vector<int> index(blocks.size());
+    int k = 0;
+    for(int j = 0; j <= b; j++) index[j] = k++;
+    for(int j = first; j <= cont; j++) index[j] = k++;
+    for(int j = b + 1; j < first; j++) index[j] = k++;
+    f.renumber(index);
+    return b + 1 + g.blocks.size();
+}
+
+
+// inlines the small callees outside f's own component, whose bodies are final
+bool inliner::run(irFunc& f) {
+    int self = &f - mod.funcs.data();
+    bool changed = false;
+    for(size_t b = 0; b < f.blocks.size(); b++) {
+        for(size_t i = 0; i < f.blocks[b].insts.size(); i++) {
+            int g = callee(f.blocks[b].insts[i]);
+            if(g < 0 || component[g] == component[self] || cost(mod.funcs[g]) > static_cast<size_t>(limit)) continue;
+            // carry on in the continuation: calls copied in with g stay calls
+            b = expand(f,b,i,mod.funcs[g]);
+            i = static_cast<size_t>(-1);
+            changed = true;
+        }
+    }
+    return changed;
+}
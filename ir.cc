@@ -0,0 +1,250 @@
+#include "include/ir.h"
+
+#include <algorithm>
+#include <format>
+
+static const char *opnames[] = {
+    "copy","add","sub","mul","div","shl","sar","neg",
+    "lt","le","gt","ge","eq","ne",
+    "addr","load","store","blkcopy","blkzero","call","param","phi",
+    "vsplat","vmov","vload","vstore","vadd","vsub","vsum",
+    "jmp","br","ret",
+};
+
+
+// a call whose result is returned right away
+bool irBlock::isTailCall(size_t i)const {
+    return insts.size() >= 2 && i == insts.size() - 2 && insts[i].op == irOp::call &&
+           insts[i + 1].op == irOp::ret && insts[i + 1].a == irVal::reg(insts[i].dst);
+}
+
+
+void irFunc::computePreds() {
+    for(auto &b : blocks) b.preds.clear();
+    for(size_t i = 0; i < blocks.size(); i++) {
+        for(int s : blocks[i].succs) blocks[s].preds.push_back(i);
+    }
+}
+
+
+/*
+ * moves block i to index[i], dropping the blocks mapped to -1 along with
+ * the phi arguments that came from them.
+ */
+void irFunc::renumber(const std::vector<int>& index) {
+    int n = 0;
+    for(int i : index) n = std::max(n,i + 1);
+    std::vector<irBlock> moved(n);
+    for(size_t i = 0; i < blocks.size(); i++) {
+        if(index[i] < 0) continue;
+        auto &b = moved[index[i]] = std::move(blocks[i]);
+        for(int &s : b.succs) s = index[s];
+        for(auto &in : b.insts) {
+            if(in.op != irOp::phi) continue;
+            size_t k = 0;
+            for(size_t j = 0; j < in.incoming.size(); j++) {
+                if(index[in.incoming[j]] < 0) continue;
+                in.incoming[k] = index[in.incoming[j]];
+                in.args[k++] = in.args[j];
+            }
+            in.incoming.resize(k);
+            in.args.resize(k);
+        }
+    }
+    blocks = std::move(moved);
+    computePreds();
+}
+
+
+// only the locals still addressed need frame space, the lowest one bounds it
+void irFunc::shrinkFrame() {
+    int64_t low = 0;
+    for(auto &b : blocks) {
+        for(auto &in : b.insts) {
+            in.mapUses([&](irVal& v) {
+                if(v.kind == irVal::Kind::V_local) low = std::min(low,v.v);
+            });
+        }
+    }
+    frame = (-low + 7) / 8 * 8;
+}
+
+
+// can a pointer into the frame exist? then the frame must outlive any call
+bool irFunc::addressesFrame()const {
+    for(auto &b : blocks) {
+        for(auto &in : b.insts) {
+            if(in.op == irOp::addr && in.a.kind == irVal::Kind::V_local) return true;
+        }
+    }
+    return false;
+}
+
+
+bool irCompare(irOp cc,int64_t a,int64_t b) {
+    switch(cc) {
+        case irOp::lt: return a < b;
+        case irOp::le: return a <= b;
+        case irOp::gt: return a > b;
+        case irOp::ge: return a >= b;
+        case irOp::eq: return a == b;
+        default:       return a != b;
+    }
+}
+
+
+irOp irSwapped(irOp cc) {
+    static const irOp sw[] = { irOp::gt,irOp::ge,irOp::lt,irOp::le,irOp::eq,irOp::ne };
+    return sw[static_cast<int>(cc) - static_cast<int>(irOp::lt)];
+}
+
+
+int irModule::intern(std::string_view name) {
+    auto it = _symids.find(std::string(name));
+    if(it != _symids.end()) return it->second;
+    int id = syms.size();
+    syms.emplace_back(name);
+    _symids.emplace(name,id);
+    return id;
+}
+
+
+static std::string valstr(const irModule& m,const irVal& v) {
+    switch(v.kind) {
+        case irVal::Kind::V_reg:    return std::format("%{}",v.v);
+        case irVal::Kind::V_imm:    return std::format("{}",v.v);
+        case irVal::Kind::V_local:  return std::format("local({})",v.v);
+        case irVal::Kind::V_global: return std::format("@{}",m.symName(v.v));
+        case irVal::Kind::V_vec:    return std::format("v{}",v.v);
+        default: return "_";
+    }
+}
+
+
+void irModule::dump(std::string& buf)const {
+    for(auto &g : globals) {
+        if(g.is_string) {
+            buf += std::format("string @{} \"{}\"\n",g.name,g.str);
+            continue;
+        }
+        buf += std::format("{} @{} {}",g.readonly ? "const" : "global",g.name,g.size);
+        for(size_t k = 0; k < g.init.size(); k++) {
+            auto &d = g.init[k];
+            buf += k ? ", " : " = ";
+            if(d.sym < 0) buf += std::format("{}",d.v);
+            else if(d.v) buf += std::format("@{}{:+}",symName(d.sym),d.v);
+            else buf += std::format("@{}",symName(d.sym));
+        }
+        buf.push_back('\n');
+    }
+    for(auto &f : funcs) {
+        buf += std::format("\nfunc {}(params {}, frame {}) {{\n",f.name,f.nparams,f.frame);
+        for(size_t i = 0; i < f.blocks.size(); i++) {
+            auto &b = f.blocks[i];
+            buf += std::format("bb{}:",i);
+            if(!b.preds.empty()) {
+                buf += "                ; preds";
+                for(int p : b.preds) buf += std::format(" bb{}",p);
+            }
+            buf.push_back('\n');
+            for(auto &in : b.insts) {
+                buf += "  ";
+                if(in.dst >= 0) buf += std::format("%{} = ",in.dst);
+                buf += opnames[static_cast<int>(in.op)];
+                if(in.op == irOp::load || in.op == irOp::store || in.isVector()) buf += std::format(".{}",in.size);
+                switch(in.op) {
+                    case irOp::phi:
+                        for(size_t k = 0; k < in.args.size(); k++) {
+                            buf += std::format("{} [{}, bb{}]",k ? "," : "",valstr(*this,in.args[k]),in.incoming[k]);
+                        }
+                        break;
+                    case irOp::call: {
+                        buf += std::format(" {}(",symName(in.sym));
+                        for(size_t k = 0; k < in.args.size(); k++) {
+                            if(k) buf += ", ";
+                            buf += valstr(*this,in.args[k]);
+                        }
+                        buf.push_back(')');
+                        break;
+                    }
+                    case irOp::jmp:
+                        buf += std::format(" bb{}",b.succs[0]);
+                        break;
+                    case irOp::br:
+                        buf += std::format(" {} {}, {}, bb{}, bb{}",opnames[static_cast<int>(in.cond)],
+                                           valstr(*this,in.a),valstr(*this,in.b),b.succs[0],b.succs[1]);
+                        break;
+                    default:
+                        if(!in.a.isNone()) buf += " " + valstr(*this,in.a);
+                        if(!in.b.isNone()) buf += ", " + valstr(*this,in.b);
+                        for(auto &arg : in.args) buf += ", " + valstr(*this,arg);
+                        break;
+                }
+                buf.push_back('\n');
+            }
+        }
+        buf += "}\n";
+    }
+}
+
+
+irLiveness::irLiveness(const irFunc& f) {
+    size_t n = f.blocks.size(),words = (f.nregs + 63) / 64;
+    auto set = [](std::vector<uint64_t>& s,int r) { s[r >> 6] |= uint64_t{1} << (r & 63); };
+    std::vector<std::vector<uint64_t>> use(n,std::vector<uint64_t>(words)),def(n,std::vector<uint64_t>(words));
+    in.assign(n,std::vector<uint64_t>(words));
+    out.assign(n,std::vector<uint64_t>(words));
+    for(size_t i = 0; i < n; i++) {
+        for(auto &inst : f.blocks[i].insts) {
+            if(inst.op != irOp::phi)
+                inst.forUses([&](int r) { if(!has(def[i],r)) set(use[i],r); });
+            if(inst.dst >= 0) set(def[i],inst.dst);
+        }
+        // phi arguments flowing along the edges out of this block
+        for(int s : f.blocks[i].succs) {
+            for(auto &inst : f.blocks[s].insts) {
+                if(inst.op != irOp::phi) break;
+                for(size_t k = 0; k < inst.args.size(); k++) {
+                    if(inst.incoming[k] == static_cast<int>(i) && inst.args[k].isReg()) set(out[i],inst.args[k].v);
+                }
+            }
+        }
+    }
+
+    // postorder visits successors first, so most blocks see their final
+    // successor sets on the first pass
+    std::vector<int> order;
+    std::vector<uint8_t> seen(n);
+    std::vector<std::pair<int,size_t>> stack;
+    for(size_t root = 0; root < n; root++) {
+        if(seen[root]) continue;
+        seen[root] = 1;
+        stack.emplace_back(root,0);
+        while(!stack.empty()) {
+            auto &[b,k] = stack.back();
+            auto &succs = f.blocks[b].succs;
+            if(k < succs.size()) {
+                int s = succs[k++];
+                if(!seen[s]) { seen[s] = 1; stack.emplace_back(s,0); }
+            } else {
+                order.push_back(b);
+                stack.pop_back();
+            }
+        }
+    }
+
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(int i : order) {
+            auto &o = out[i];
+            for(int s : f.blocks[i].succs) {
+                for(size_t w = 0; w < words; w++) o[w] |= in[s][w];
+            }
+            for(size_t w = 0; w < words; w++) {
+                uint64_t live = use[i][w] | (o[w] & ~def[i][w]);
+                if(live != in[i][w]) { in[i][w] = live; changed = true; }
+            }
+        }
+    }
+}
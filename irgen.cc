@@ -0,0 +1,468 @@
+#include "include/irgen.h"
+
+#include <algorithm>
+
+
+int irgenerator::newBlock() {
+    func->blocks.emplace_back();
+    return func->blocks.size() - 1;
+}
+
+
+void irgenerator::setBlock(int b) {
+    cur = b;
+    order.push_back(b);
+}
+
+
+bool irgenerator::terminated()const {
+    auto &insts = func->blocks[cur].insts;
+    return !insts.empty() && insts.back().isTerminator();
+}
+
+
+// code following a return still needs a block to live in, even if nothing reaches it
+void irgenerator::append(irInst in) {
+    if(terminated()) setBlock(newBlock());
+    func->blocks[cur].insts.push_back(std::move(in));
+}
+
+
+void irgenerator::jump(int target) {
+    if(terminated()) return;
+    append({irOp::jmp});
+    func->blocks[cur].succs = {target};
+}
+
+
+void irgenerator::branch(const irVal& cond,int then,int other) {
+    append({irOp::br,-1,cond,irVal::imm(0)});
+    func->blocks[cur].succs = {then,other};
+}
+
+
+static bool compareOp(tokenType tk,irOp& o) {
+    switch(tk) {
+        case tokenType::T_lt:  o = irOp::lt;return true;
+        case tokenType::T_le:  o = irOp::le;return true;
+        case tokenType::T_gt:  o = irOp::gt;return true;
+        case tokenType::T_ge:  o = irOp::ge;return true;
+        case tokenType::T_eq:  o = irOp::eq;return true;
+        case tokenType::T_neq: o = irOp::ne;return true;
+        default: return false;
+    }
+}
+
+
+// a comparison in control-flow context branches on it directly, without a 0/1 value
+void irgenerator::condition(Node *cond,int then,int other) {
+    irOp o;
+    if(cond->equal(Node::Kind::N_binary) && compareOp(static_cast<binaryNode*>(cond)->getOp(),o)) {
+        auto bin = static_cast<binaryNode*>(cond);
+        irVal l = lower(*bin->getLhs());
+        irVal r = lower(*bin->getRhs());
+        irInst br{irOp::br,-1,l,r};
+        br.cond = o;
+        append(std::move(br));
+        func->blocks[cur].succs = {then,other};
+        return;
+    }
+    branch(lower(*cond),then,other);
+}
+
+
+irVal irgenerator::op(irOp op,const irVal& a,const irVal& b) {
+    int dst = func->newReg();
+    append({op,dst,a,b});
+    return irVal::reg(dst);
+}
+
+
+static int log2(int64_t n) {
+    if(n <= 0 || (n & (n - 1)) != 0) return -1;
+    return __builtin_ctzll(n);
+}
+
+
+// v * size, as a shift when size is a power of two
+irVal irgenerator::scale(const irVal& v,int64_t size) {
+    int k = log2(size);
+    if(k == 0) return v;
+    if(k > 0) return op(irOp::shl,v,irVal::imm(k));
+    return op(irOp::mul,v,irVal::imm(size));
+}
+
+
+irVal irgenerator::lower(Node& node) {
+    node.accept(*this);
+    return val;
+}
+
+
+irVal irgenerator::materialize(const irVal& v) {
+    if(v.isAddr()) return op(irOp::addr,v);
+    return v;
+}
+
+
+void irgenerator::block(irOp op,const irVal& addr,int64_t n,const irVal& src) {
+    irInst in{op,-1,addr,src};
+    in.args.push_back(irVal::imm(n));
+    append(std::move(in));
+}
+
+
+irVal irgenerator::load(const irVal& addr,size_t size) {
+    int dst = func->newReg();
+    irInst in{irOp::load,dst,addr};
+    in.size = size == 1 ? 1 : 8;
+    append(std::move(in));
+    return irVal::reg(dst);
+}
+
+
+/*
+ * the vreg of a local scalar that lives in a register, created on first
+ * use, or -1 when its address is taken and it has to stay in the frame
+ */
+int irgenerator::variable(int offset) {
+    auto it = promoted.find(offset);
+    if(it != promoted.end()) return it->second;
+    if(fdef->isAddressTaken(offset)) return -1;
+    int r = func->newReg();
+    promoted[offset] = r;
+    return r;
+}
+
+
+// a local that can be kept in a register: an 8-byte scalar
+static bool promotable(identNode& ident) {
+    return !ident.isGlobal() && !Type::isArray(ident.getType()) && ident.typeSize() == 8;
+}
+
+
+// the address of an lvalue: a local or global the backend can address
+// directly, or a register holding a computed address
+irVal irgenerator::location(Node& node) {
+    if(node.equal(Node::Kind::N_identifier)) {
+        auto &ident = static_cast<identNode&>(node);
+        if(ident.isGlobal()) return irVal::global(mod.intern(ident.getName()));
+        return irVal::local(ident.getOffset());
+    }
+    else if(node.equal(Node::Kind::N_arrayvisit)) {
+        auto &arr = static_cast<arrayVisit&>(node);
+        irVal var = arr.isGlobal() ? irVal::global(mod.intern(arr.getName())) : irVal::local(arr.getOffset());
+        irVal base;
+        if(arr.isArray()) base = op(irOp::addr,var);
+        else if(int r = arr.isGlobal() ? -1 : variable(arr.getOffset()); r >= 0) base = irVal::reg(r);
+        else base = load(var,8);
+        irVal idx = lower(*arr.get_idx());
+        int64_t size = arr.typeSize();
+        if(idx.isImm()) {
+            if(idx.v == 0) return base;
+            return op(irOp::add,base,irVal::imm(idx.v * size));
+        }
+        return op(irOp::add,base,scale(idx,size));
+    }
+    else if(node.equal(Node::Kind::N_deref)) {
+        auto &prefix = static_cast<prefixNode&>(node);
+        return lower(*prefix.getNode());
+    }
+    else if(node.equal(Node::Kind::N_string)) {
+        auto &str = static_cast<stringNode&>(node);
+        return irVal::global(mod.intern(str.symbol()));
+    }
+    exit(-1);
+}
+
+
+void irgenerator::visit(numericNode& node) {
+    val = irVal::imm(node.Value());
+}
+
+void irgenerator::visit(identNode& node) {
+    if(int r = promotable(node) ? variable(node.getOffset()) : -1; r >= 0) {
+        val = irVal::reg(r);
+        return;
+    }
+    irVal addr = location(node);
+    val = Type::isArray(node.getType()) ? materialize(addr) : load(addr,node.typeSize());
+}
+
+void irgenerator::visit(stringNode& node) {
+    val = materialize(location(node));
+}
+
+
+void irgenerator::visit(prefixNode& node) {
+    if(node.equal(Node::Kind::N_addr)) {
+        val = materialize(location(*node.getNode()));
+    }else if(node.equal(Node::Kind::N_deref)) {
+        irVal addr = lower(*node.getNode());
+        val = Type::isArray(node.getType()) ? addr : load(addr,node.typeSize());
+    }else {
+        irVal v = lower(*node.getNode());
+        val = v.isImm() ? irVal::imm(-static_cast<uint64_t>(v.v)) : op(irOp::neg,v);
+    }
+}
+
+
+void irgenerator::visit(funcallNode& node) {
+    irInst call{irOp::call,func->newReg()};
+    call.sym = mod.intern(node.getName());
+    for(auto &arg : node.getArgs()) {
+        call.args.push_back(lower(*arg));
+    }
+    val = irVal::reg(call.dst);
+    append(std::move(call));
+}
+
+
+void irgenerator::visit(binaryNode& node) {
+    tokenType tk = node.getOp();
+    auto lhs = node.getLhs();
+    auto rhs = node.getRhs();
+    if(tk == tokenType::T_assign) {
+        if(lhs->equal(Node::Kind::N_identifier)) {
+            auto ident = static_cast<identNode*>(lhs);
+            if(int r = promotable(*ident) ? variable(ident->getOffset()) : -1; r >= 0) {
+                val = lower(*rhs);
+                append({irOp::copy,r,val});
+                return;
+            }
+        }
+        irVal addr = location(*lhs);
+        irVal v = lower(*rhs);
+        irInst store{irOp::store,-1,addr,v};
+        store.size = lhs->getType()->getSize() == 1 ? 1 : 8;
+        append(std::move(store));
+        val = v;
+        return;
+    }
+    irVal l = lower(*lhs);
+    irVal r = lower(*rhs);
+    irOp o;
+    switch(tk) {
+        case tokenType::T_plus:  o = irOp::add;break;
+        case tokenType::T_minus: o = irOp::sub;break;
+        case tokenType::T_star:  o = irOp::mul;break;
+        case tokenType::T_div:   o = irOp::div;break;
+        default:
+            if(!compareOp(tk,o)) exit(-1);
+    }
+    if(o == irOp::mul && l.isImm() && !r.isImm()) std::swap(l,r);
+    if(o == irOp::mul && r.isImm() && log2(r.v) >= 0) {
+        val = scale(l,r.v);
+        return;
+    }
+    // an exact division by 2^k is a plain arithmetic shift
+    if(o == irOp::div && node.isExact() && r.isImm() && log2(r.v) > 0) {
+        val = op(irOp::sar,l,irVal::imm(log2(r.v)));
+        return;
+    }
+    val = op(o,l,r);
+}
+
+
+void irgenerator::visit(arrayVisit& v) {
+    irVal addr = location(v);
+    val = Type::isArray(v.getType()) ? addr : load(addr,v.typeSize());
+}
+
+
+/*
+ * an initialized local array. with enough constants among the values they
+ * are copied in from a .rodata image, the rest are stored one by one; the
+ * elements without a value are zeroed.
+ */
+void irgenerator::visit(arraydef& def) {
+    auto inits = def.get_init_lst();
+    if(inits.empty()) return;
+    int offset = def.getOffset();
+    int64_t size = def.elemSize();
+    std::vector<irVal> vals;
+    for(auto &init : inits) vals.push_back(lower(*init));
+    int64_t n = vals.size() * size;
+
+    auto constant = [](const irVal& v) { return v.isImm(); };
+    bool image = std::count_if(vals.begin(),vals.end(),constant) * size >= imageBytes;
+    if(image) {
+        irGlobal g{std::format(".L.init.{}",mod.globals.size()),static_cast<size_t>(n),false,{},true};
+        g.elem = size == 1 ? 1 : 8;
+        for(auto &v : vals) g.init.push_back({v.isImm() ? v.v : 0});
+        mod.globals.push_back(std::move(g));
+        block(irOp::blkcopy,irVal::local(offset),n,irVal::global(mod.intern(mod.globals.back().name)));
+    }
+    for(size_t i = 0; i < vals.size(); i++) {
+        if(image && vals[i].isImm()) continue;
+        irInst store{irOp::store,-1,irVal::local(offset + i * size),vals[i]};
+        store.size = size == 1 ? 1 : 8;
+        append(std::move(store));
+    }
+    if(n < static_cast<int64_t>(def.typeSize())) block(irOp::blkzero,irVal::local(offset + n),def.typeSize() - n);
+}
+
+
+void irgenerator::visit(whileStmt& S) {
+    int cond = newBlock();
+    jump(cond);
+    setBlock(cond);
+    int body = newBlock();
+    int end = newBlock();
+    condition(S.getCond(),body,end);
+    setBlock(body);
+    S.compileBody(*this);
+    jump(cond);
+    setBlock(end);
+}
+
+
+void irgenerator::visit(forStmt& S) {
+    S.compileInit(*this);
+    int cond = newBlock();
+    jump(cond);
+    setBlock(cond);
+    int body = newBlock();
+    int end = newBlock();
+    if(auto c = S.getCond()) condition(c,body,end);
+    else jump(body);
+    setBlock(body);
+    S.compileBody(*this);
+    S.compileInc(*this);
+    jump(cond);
+    setBlock(end);
+}
+
+
+void irgenerator::visit(ifStmt& S) {
+    auto then = S.getThen();
+    auto elseStmt = S.getElse();
+    int then_bb = newBlock();
+    int else_bb = elseStmt ? newBlock() : -1;
+    int end = newBlock();
+    condition(S.getCond(),then_bb,elseStmt ? else_bb : end);
+    setBlock(then_bb);
+    if(then) then->accept(*this);
+    jump(end);
+    if(elseStmt) {
+        setBlock(else_bb);
+        elseStmt->accept(*this);
+        jump(end);
+    }
+    setBlock(end);
+}
+
+
+void irgenerator::visit(retStmt& S) {
+    irVal v;
+    if(S.compileStmt(*this)) v = val;
+    append({irOp::ret,-1,v});
+}
+
+
+void irgenerator::visit(exprStmt& S) {
+    val = lower(*S.getNode());
+}
+
+
+void irgenerator::visit(blockStmt& S) {
+    S.compileStmts(*this);
+}
+
+
+// a global's initial value, which the parser made sure is a constant
+irDatum irgenerator::datum(Node& init) {
+    auto c = evaluate(init).value();
+    return {c.v,c.sym.empty() ? -1 : mod.intern(c.sym)};
+}
+
+
+void irgenerator::visit(vardef& vars) {
+    auto decls = vars.getDeclas();
+    if(vars.isGlobal()) {
+        for(auto &var : decls) {
+            if(var->equal(Node::Kind::N_string)) {
+                auto str = static_cast<stringNode*>(var);
+                mod.globals.push_back({str->symbol(),str->strView().size() + 1,true,str->strView(),true});
+            } else if(var->equal(Node::Kind::N_identifier)) {
+                mod.globals.push_back({var->strView(),var->typeSize(),false,{}});
+            } else if(var->equal(Node::Kind::N_binary)) {
+                auto bin = static_cast<binaryNode*>(var);
+                irGlobal g{bin->getLhs()->strView(),bin->typeSize(),false,{}};
+                g.elem = g.size == 1 ? 1 : 8;
+                g.init.push_back(datum(*bin->getRhs()));
+                mod.globals.push_back(std::move(g));
+            } else if(var->equal(Node::Kind::N_arraydef)) {
+                auto def = static_cast<arraydef*>(var);
+                irGlobal g{def->getName(),def->typeSize(),false,{}};
+                g.elem = def->elemSize() == 1 ? 1 : 8;
+                for(auto &init : def->get_init_lst()) g.init.push_back(datum(*init));
+                mod.globals.push_back(std::move(g));
+            }
+        }
+    }
+    else{
+        for(auto &var : decls) {
+            if(var->equal(Node::Kind::N_binary) || var->equal(Node::Kind::N_arraydef)) {
+                var->accept(*this);
+            }
+        }
+    }
+}
+
+
+// renumber the blocks into the order they were entered, which follows the source
+void irgenerator::layout() {
+    std::vector<int> index(func->blocks.size(),-1);
+    for(size_t i = 0; i < order.size(); i++) index[order[i]] = i;
+    std::vector<irBlock> blocks(order.size());
+    for(size_t i = 0; i < order.size(); i++) {
+        blocks[i] = std::move(func->blocks[order[i]]);
+        for(int &s : blocks[i].succs) s = index[s];
+    }
+    func->blocks = std::move(blocks);
+    func->computePreds();
+}
+
+
+void irgenerator::visit(funcdef& f) {
+    mod.funcs.emplace_back();
+    func = &mod.funcs.back();
+    func->name = f.getName();
+    func->frame = f.getStackOff();
+    fdef = &f;
+    order.clear();
+    setBlock(newBlock());
+
+    // a parameter whose address is never taken lives in a register, like
+    // other locals. char parameters excepted: their frame slot truncates
+    // what the caller passed
+    auto params = f.getParams();
+    func->nparams = params.size();
+    promoted.clear();
+    std::vector<irVal> incoming;
+    for(size_t i = 0; i < params.size(); i++) {
+        auto param = static_cast<identNode*>(params[i]);
+        incoming.push_back(op(irOp::param,irVal::imm(i)));
+        if(param->typeSize() == 8 && !f.isAddressTaken(param->getOffset()))
+            promoted[param->getOffset()] = incoming[i].v;
+    }
+    for(size_t i = 0; i < params.size(); i++) {
+        auto param = static_cast<identNode*>(params[i]);
+        if(promoted.count(param->getOffset())) continue;
+        irInst store{irOp::store,-1,irVal::local(param->getOffset()),incoming[i]};
+        store.size = param->typeSize() == 1 ? 1 : 8;
+        append(std::move(store));
+    }
+
+    f.getBody()->accept(*this);
+    if(!terminated()) append({irOp::ret,-1,irVal::imm(0)});
+    layout();
+}
+
+
+void irgenerator::visit(Prog& p) {
+    for(auto &stmt : p._stmts) {
+        stmt->accept(*this);
+    }
+}
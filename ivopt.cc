@@ -0,0 +1,232 @@
+#include "include/ivopt.h"
+
+#include <algorithm>
+
+
+// m*x + k within 2GB either way, too close to a pointer to wrap around with it
+static bool nearby(int64_t m,int64_t x,int64_t k) {
+    __int128 off = static_cast<__int128>(m) * x + k;
+    return off >= INT32_MIN && off <= INT32_MAX;
+}
+
+
+// base + m*x + k, computed ahead of the loop
+irVal ivopt::start(std::vector<irInst>& insts,const affine& f,const irVal& x) {
+    irVal v = emit(insts,irOp::mul,x,irVal::imm(f.m));
+    v = emit(insts,irOp::add,v,irVal::imm(f.k));
+    return f.base.isNone() ? v : emit(insts,irOp::add,f.base,v);
+}
+
+
+void ivopt::reduce(const irLoop& l) {
+    auto &blocks = func.blocks;
+    if(l.latches.size() != 1) return;
+    int h = l.header,latch = l.latches[0],pre = l.preheader;
+    locate();
+
+    // header phis stepped by a constant on the back edge
+    std::vector<affine> forms(func.nregs);
+    ivs.clear();
+    for(auto &in : blocks[h].insts) {
+        if(in.op != irOp::phi) break;
+        if(in.args.size() != 2) continue;
+        int kp = in.incoming[0] == pre ? 0 : 1;
+        irVal next = in.args[1 - kp];
+        if(in.incoming[kp] != pre || !next.isReg() || !l.contains(defblock[next.v])) continue;
+        const irInst *d = defs[next.v];
+        irVal self = irVal::reg(in.dst);
+        int64_t step;
+        if(d->op == irOp::add && d->a == self && d->b.isImm()) step = d->b.v;
+        else if(d->op == irOp::add && d->b == self && d->a.isImm()) step = d->a.v;
+        else if(d->op == irOp::sub && d->a == self && d->b.isImm()) step = -d->b.v;
+        else continue;
+        ivs.push_back({in.dst,static_cast<int>(next.v),in.args[kp],step});
+        forms[in.dst] = {in.dst,1,{},0};
+    }
+    if(ivs.empty()) return;
+
+    // what the loop computes as base + m*iv + k, operands first
+    auto formOf = [&](const irVal& v) { return v.isReg() ? forms[v.v] : affine{}; };
+    for(int b : form.rpo()) {
+        if(!l.contains(b)) continue;
+        for(auto &in : blocks[b].insts) {
+            if(in.dst >= 0 && in.op != irOp::phi) forms[in.dst] = follow(in,formOf(in.a),formOf(in.b),l);
+        }
+    }
+
+    // addresses read by something other than more address arithmetic
+    std::vector<int> roots;
+    for(size_t b = 0; b < blocks.size(); b++) {
+        if(!l.contains(b)) continue;
+        for(auto &in : blocks[b].insts) {
+            if(in.dst >= 0 && forms[in.dst].iv >= 0) continue;
+            in.forUses([&](int r) {
+                if(forms[r].iv < 0 || forms[r].base.isNone() || forms[r].m == 0) return;
+                if(std::find(roots.begin(),roots.end(),r) == roots.end()) roots.push_back(r);
+            });
+        }
+    }
+    if(roots.empty()) return;
+
+    std::vector<irInst> setup;
+    std::vector<int> ptrs;
+    for(int r : roots) {
+        const affine &f = forms[r];
+        auto it = std::find_if(done.begin(),done.end(),[&](const reduced& d) { return d.f == f; });
+        int q;
+        if(it != done.end()) {
+            q = it->ptr;
+        }else {
+            const basic &iv = *std::find_if(ivs.begin(),ivs.end(),[&](const basic& b) { return b.phi == f.iv; });
+            irVal q0 = start(setup,f,iv.init);
+            q = func.newReg();
+            int qn = func.newReg();
+            irInst phi{irOp::phi,q};
+            for(int p : blocks[h].preds) {
+                phi.args.push_back(p == pre ? q0 : irVal::reg(qn));
+                phi.incoming.push_back(p);
+            }
+            blocks[h].insts.insert(blocks[h].insts.begin(),std::move(phi));
+            auto &tail = blocks[latch].insts;
+            tail.insert(tail.end() - 1,irInst{irOp::add,qn,irVal::reg(q),irVal::imm(wrapMul(f.m,iv.step))});
+            done.push_back({f.iv,q,f});
+        }
+        ptrs.push_back(q);
+    }
+    auto &head = blocks[pre].insts;
+    head.insert(head.end() - 1,setup.begin(),setup.end());
+
+    // the pointer holds the same value wherever the loop reads the address
+    for(size_t b = 0; b < blocks.size(); b++) {
+        if(!l.contains(b)) continue;
+        for(auto &in : blocks[b].insts) {
+            in.mapUses([&](irVal& v) {
+                if(!v.isReg()) return;
+                auto it = std::find(roots.begin(),roots.end(),v.v);
+                if(it != roots.end() && in.dst != ptrs[it - roots.begin()]) v.v = ptrs[it - roots.begin()];
+            });
+        }
+    }
+}
+
+
+/*
+ * does the pointer stay within an object, where it cannot wrap around? it
+ * does when its base is the address of one, or when the program only
+ * loads and stores through it. 'step' is the pointer one iteration on.
+ */
+bool ivopt::pointsIntoObject(const reduced& r,int step)const {
+    bool object = false,other = false;
+    irVal p = irVal::reg(r.ptr),q = irVal::reg(step);
+    auto is = [&](const irVal& v) { return v == p || v == q; };
+    for(auto &b : func.blocks) {
+        for(auto &in : b.insts) {
+            if(r.f.base.isReg() && in.dst == r.f.base.v) object = in.op == irOp::addr;
+            if(in.dst == r.ptr || in.dst == step) continue;
+            switch(in.op) {
+                // as the address of a load or a store, but not as the value stored
+                case irOp::store:
+                    other |= is(in.b);
+                    break;
+                case irOp::load:
+                case irOp::vload:
+                case irOp::vstore:
+                case irOp::blkcopy:
+                case irOp::blkzero:
+                    break;
+                default: in.forUses([&](int u) { other |= u == r.ptr || u == step; });
+            }
+        }
+    }
+    return object || !other;
+}
+
+
+// with the address stepping along, the counter is only needed by its own test
+void ivopt::replaceTest(const reduced& r,const loopinfo& info) {
+    auto &blocks = func.blocks;
+    const irLoop *loop = nullptr;
+    const irInst *phi = nullptr,*ptr = nullptr;
+    for(auto &l : info.loops()) {
+        for(auto &in : blocks[l.header].insts) {
+            if(in.op != irOp::phi) break;
+            if(in.dst == r.iv) phi = &in,loop = &l;
+            if(in.dst == r.ptr) ptr = &in;
+        }
+        if(loop) break;
+    }
+    if(!loop || !ptr || loop->latches.size() != 1 || r.f.m == 0) return;
+    int step = -1;
+    for(size_t k = 0; k < ptr->args.size(); k++) {
+        if(ptr->incoming[k] == loop->latches[0] && ptr->args[k].isReg()) step = ptr->args[k].v;
+    }
+    if(step < 0 || !pointsIntoObject(r,step)) return;
+    int next = -1;
+    irVal init;
+    for(size_t k = 0; k < phi->args.size(); k++) {
+        if(phi->incoming[k] == loop->latches[0] && phi->args[k].isReg()) next = phi->args[k].v;
+        if(phi->incoming[k] == loop->preheader) init = phi->args[k];
+    }
+    if(next < 0) return;
+
+    std::vector<irInst*> tests;
+    bool other = false;
+    for(size_t b = 0; b < blocks.size(); b++) {
+        for(auto &in : blocks[b].insts) {
+            bool usesIv = false,usesNext = false;
+            in.forUses([&](int u) {
+                usesIv |= u == r.iv;
+                usesNext |= u == next;
+            });
+            if(in.dst == next) continue;
+            if(usesNext && !(in.op == irOp::phi && in.dst == r.iv)) other = true;
+            if(!usesIv || (in.op == irOp::phi && in.dst == r.iv)) continue;
+            /*
+             * the pointer only orders the same way as the counter while
+             * neither wraps, so the counter has to start and stop at known
+             * constants that keep the pointer close to its base.
+             */
+            bool test = in.op == irOp::br && loop->contains(b) &&
+                        ((in.a == irVal::reg(r.iv) && in.b.isImm()) ||
+                         (in.b == irVal::reg(r.iv) && in.a.isImm()));
+            if(test) {
+                int64_t bound = in.a.isImm() ? in.a.v : in.b.v;
+                test = init.isImm() && nearby(r.f.m,init.v,r.f.k) && nearby(r.f.m,bound,r.f.k);
+            }
+            if(test) tests.push_back(&in);
+            else other = true;
+        }
+    }
+    if(other || tests.empty()) return;
+
+    std::vector<irInst> setup;
+    for(auto *br : tests) {
+        if(br->b == irVal::reg(r.iv)) {
+            std::swap(br->a,br->b);
+            br->cond = irSwapped(br->cond);
+        }
+        // a negative scale runs the other way
+        if(r.f.m < 0) br->cond = irSwapped(br->cond);
+        br->b = start(setup,r.f,br->b);
+        br->a = irVal::reg(r.ptr);
+    }
+    auto &head = blocks[loop->preheader].insts;
+    head.insert(head.end() - 1,setup.begin(),setup.end());
+}
+
+
+void ivopt::run() {
+    {
+        loopinfo info(func,form);
+        info.analyze();
+        for(auto &l : info.loops()) reduce(l);
+    }
+    if(done.empty()) return;
+    // the arithmetic the pointers replaced goes first, then the counters that only test
+    form.eliminateDeadCode();
+    loopinfo info(func,form);
+    info.analyze();
+    locate();
+    for(auto &r : done) replaceTest(r,info);
+    form.eliminateDeadCode();
+}
@@ -0,0 +1,139 @@
+#include "include/jit.h"
+
+#include <elf.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+
+// what a program may call without defining it
+static const struct { const char *name; void *addr; } libc[] = {
+    { "putchar",reinterpret_cast<void*>(&putchar) },
+    { "puts",reinterpret_cast<void*>(&puts) },
+    { "printf",reinterpret_cast<void*>(&printf) },
+    { "exit",reinterpret_cast<void*>(&exit) },
+    { "abort",reinterpret_cast<void*>(&abort) },
+    { "malloc",reinterpret_cast<void*>(&malloc) },
+    { "calloc",reinterpret_cast<void*>(&calloc) },
+    { "free",reinterpret_cast<void*>(&free) },
+    { "strlen",reinterpret_cast<void*>(&strlen) },
+    { "strcmp",reinterpret_cast<void*>(&strcmp) },
+    { "memcpy",reinterpret_cast<void*>(&memcpy) },
+    { "memset",reinterpret_cast<void*>(&memset) },
+};
+
+// jmp *0(%rip) followed by the absolute target
+static constexpr size_t stubSize = 16;
+
+
+static size_t pageAlign(size_t n) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (n + page - 1) / page * page;
+}
+
+
+jit::~jit() {
+    if(region) munmap(region,length);
+}
+
+
+void *jit::resolve(std::string_view name)const {
+    for(auto &f : libc) {
+        if(name == f.name) return f.addr;
+    }
+    return nullptr;
+}
+
+
+/*
+ * layout: [.text + stubs] [.rodata .rodata.str1.1] [.data], each starting
+ * on a page so that it can get its own protection once the relocations
+ * are applied.
+ */
+bool jit::load() {
+    auto &syms = as.symbols();
+    size_t nstubs = 0;
+    for(auto &s : syms) {
+        if(s.section < 0) nstubs++;
+    }
+    size_t textSize = pageAlign(as.bytes(assembler::S_text).size() + nstubs * stubSize);
+    size_t rodataSize = pageAlign(as.bytes(assembler::S_rodata).size() + as.bytes(assembler::S_strings).size());
+    size_t dataSize = pageAlign(as.bytes(assembler::S_data).size());
+    length = textSize + rodataSize + dataSize;
+    void *p = mmap(nullptr,length,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+    if(p == MAP_FAILED) {
+        region = nullptr;
+        _error = std::format("mmap failed: {}",strerror(errno));
+        return false;
+    }
+    region = static_cast<uint8_t*>(p);
+    base[assembler::S_text] = region;
+    base[assembler::S_rodata] = region + textSize;
+    base[assembler::S_strings] = base[assembler::S_rodata] + as.bytes(assembler::S_rodata).size();
+    base[assembler::S_data] = region + textSize + rodataSize;
+    for(int s = 0; s < assembler::S_count; s++) {
+        auto &bytes = as.bytes(s);
+        if(!bytes.empty()) std::memcpy(base[s],bytes.data(),bytes.size());
+    }
+
+    uint8_t *stub = region + as.bytes(assembler::S_text).size();
+    addrs.resize(syms.size());
+    for(size_t i = 0; i < syms.size(); i++) {
+        auto &s = syms[i];
+        if(s.section >= 0) {
+            addrs[i] = base[s.section] + s.value;
+            continue;
+        }
+        void *target = resolve(s.name);
+        if(target == nullptr) {
+            _error = std::format("undefined symbol '{}'",s.name);
+            return false;
+        }
+        static const uint8_t jmp[] = { 0xff,0x25,0,0,0,0 };
+        std::memcpy(stub,jmp,sizeof(jmp));
+        std::memcpy(stub + sizeof(jmp),&target,sizeof(target));
+        addrs[i] = stub;
+        stub += stubSize;
+    }
+
+    for(auto &r : as.relocs()) {
+        uint8_t *where = base[r.section] + r.offset;
+        auto &s = syms[r.sym];
+        if(s.section < 0 && r.type != R_X86_64_PLT32) {
+            _error = std::format("'{}' can only be called",s.name);
+            return false;
+        }
+        if(r.type == R_X86_64_64) {
+            int64_t v = reinterpret_cast<intptr_t>(addrs[r.sym]) + r.addend;
+            std::memcpy(where,&v,sizeof(v));
+            continue;
+        }
+        int64_t v = reinterpret_cast<intptr_t>(addrs[r.sym]) + r.addend - reinterpret_cast<intptr_t>(where);
+        int32_t rel = v;
+        std::memcpy(where,&rel,sizeof(rel));
+    }
+
+    if(mprotect(base[assembler::S_text],textSize,PROT_READ | PROT_EXEC) != 0 ||
+       (rodataSize && mprotect(base[assembler::S_rodata],rodataSize,PROT_READ) != 0)) {
+        _error = std::format("mprotect failed: {}",strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+
+bool jit::run(int& status) {
+    auto &syms = as.symbols();
+    for(size_t i = 0; i < syms.size(); i++) {
+        if(syms[i].name == "main" && syms[i].section == assembler::S_text) {
+            auto entry = reinterpret_cast<int64_t(*)()>(addrs[i]);
+            status = static_cast<int>(entry());
+            std::fflush(stdout);
+            return true;
+        }
+    }
+    _error = "no 'main' to run";
+    return false;
+}
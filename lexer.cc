@@ -1,6 +1,20 @@
 #include "./include/lexer.h"
 
-std::unordered_map<std::string,tokenType> keywords = {
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+struct keyword {
+    std::string_view name;
+    tokenType type;
+};
+
+// adding a keyword is one more line here, the table below is searched for at compile time
+static constexpr keyword keywords[] = {
     { "if",tokenType::T_if },
     { "else",tokenType::T_else },
     { "int",tokenType::T_int },
@@ -10,6 +24,192 @@ std::unordered_map<std::string,tokenType> keywords = {
     { "for",tokenType::T_for },
 };
 
+static constexpr size_t minKeyword = std::ranges::min(keywords,{},[](const keyword& k) { return k.name.size(); }).name.size();
+static constexpr size_t maxKeyword = std::ranges::max(keywords,{},[](const keyword& k) { return k.name.size(); }).name.size();
+static_assert(minKeyword >= 2,"keywords are hashed on their first two characters");
+
+// slot of a word of 2 or more characters, from its length and its first, second and last characters
+static constexpr uint8_t keywordSlot(std::string_view s,uint32_t seed) {
+    uint32_t h = static_cast<uint32_t>(s.size()) | static_cast<uint32_t>(static_cast<uint8_t>(s[0])) << 8 |
+                 static_cast<uint32_t>(static_cast<uint8_t>(s[1])) << 16 | static_cast<uint32_t>(static_cast<uint8_t>(s.back())) << 24;
+    h *= seed;
+    h ^= h >> 15;
+    return (h * 0x2c1b3c6du) >> 24;
+}
+
+// a perfect hash: the first odd multiplier that sends every keyword to a slot of its own
+struct keywordTable {
+    uint32_t seed{0};
+    std::array<int8_t,256> slots{};     // index into keywords, -1 if free
+};
+
+static constexpr keywordTable keywordHash = [] {
+    static_assert(std::size(keywords) < 128);
+    keywordTable t;
+    for(t.seed = 1; t.seed < (1u << 16); t.seed += 2) {
+        t.slots.fill(-1);
+        bool perfect = true;
+        for(size_t k = 0; k < std::size(keywords) && perfect; k++) {
+            int8_t &slot = t.slots[keywordSlot(keywords[k].name,t.seed)];
+            perfect = slot < 0;
+            slot = k;
+        }
+        if(perfect) return t;
+    }
+    t.seed = 0;
+    return t;
+}();
+static_assert(keywordHash.seed != 0,"no perfect hash for the keywords, hash another character");
+
+// the keyword spelled s, T_identifier if it is none
+static tokenType keywordType(std::string_view s) {
+    if(s.size() < minKeyword || s.size() > maxKeyword) return tokenType::T_identifier;
+    int k = keywordHash.slots[keywordSlot(s,keywordHash.seed)];
+    return k >= 0 && keywords[k].name == s ? keywords[k].type : tokenType::T_identifier;
+}
+
+// what each character can start
+static constexpr std::array<charClass,256> classes = [] {
+    std::array<charClass,256> t{};
+    for(int c = 'a'; c <= 'z'; c++) t[c] = t[c - 'a' + 'A'] = charClass::C_ident;
+    for(int c = '0'; c <= '9'; c++) t[c] = charClass::C_digit;
+    t['_'] = charClass::C_ident;
+    for(char c : {' ','\t','\n','\r'}) t[c] = charClass::C_blank;
+    for(char c : {'(',')','[',']','{','}'}) t[c] = charClass::C_bracket;
+    for(char c : {'+','-','*','/','=','<','>','!'}) t[c] = charClass::C_operator;
+    for(char c : {';',',','.','&'}) t[c] = charClass::C_puct;
+    t['"'] = charClass::C_quote;
+    t[0] = charClass::C_eof;
+    return t;
+}();
+
+
+static charClass classOf(char c) {
+    return classes[static_cast<unsigned char>(c)];
+}
+
+
+/*
+ * the runs the lexer skips over in bulk: blanks, the rest of an identifier
+ * and the body of a string literal. whole 32- or 16-byte blocks are
+ * compared at once while they fit in the source, the tail byte by byte.
+ */
+enum class run { R_blank,R_ident,R_string };
+
+template<run k>
+static bool continues(char c) {
+    if constexpr(k == run::R_blank) return classOf(c) == charClass::C_blank;
+    if constexpr(k == run::R_ident) return classOf(c) == charClass::C_ident || classOf(c) == charClass::C_digit;
+    return c != '"' && c != '\0';
+}
+
+#ifdef __SSE2__
+static __m128i equal(__m128i v,char c) {
+    return _mm_cmpeq_epi8(v,_mm_set1_epi8(c));
+}
+
+
+// lo <= v <= hi, for lo and hi below 0x80 so that signed compares do
+static __m128i within(__m128i v,char lo,char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v,_mm_set1_epi8(lo - 1)),_mm_cmpgt_epi8(_mm_set1_epi8(hi + 1),v));
+}
+
+
+// bytes of the block that continue a run of kind k, one bit each
+template<run k>
+static uint32_t matches(__m128i v) {
+    __m128i m;
+    if constexpr(k == run::R_blank) {
+        m = _mm_or_si128(_mm_or_si128(equal(v,' '),equal(v,'\t')),_mm_or_si128(equal(v,'\n'),equal(v,'\r')));
+    }else if constexpr(k == run::R_ident) {
+        // setting bit 5 folds upper case onto lower case
+        __m128i alpha = within(_mm_or_si128(v,_mm_set1_epi8(0x20)),'a','z');
+        m = _mm_or_si128(_mm_or_si128(alpha,within(v,'0','9')),equal(v,'_'));
+    }else {
+        m = _mm_andnot_si128(_mm_or_si128(equal(v,'"'),equal(v,'\0')),_mm_set1_epi8(-1));
+    }
+    return _mm_movemask_epi8(m);
+}
+
+
+[[gnu::target("avx2")]] static __m256i equal(__m256i v,char c) {
+    return _mm256_cmpeq_epi8(v,_mm256_set1_epi8(c));
+}
+
+
+[[gnu::target("avx2")]] static __m256i within(__m256i v,char lo,char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v,_mm256_set1_epi8(lo - 1)),_mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1),v));
+}
+
+
+template<run k>
+[[gnu::target("avx2")]] static uint32_t matches(__m256i v) {
+    __m256i m;
+    if constexpr(k == run::R_blank) {
+        m = _mm256_or_si256(_mm256_or_si256(equal(v,' '),equal(v,'\t')),_mm256_or_si256(equal(v,'\n'),equal(v,'\r')));
+    }else if constexpr(k == run::R_ident) {
+        __m256i alpha = within(_mm256_or_si256(v,_mm256_set1_epi8(0x20)),'a','z');
+        m = _mm256_or_si256(_mm256_or_si256(alpha,within(v,'0','9')),equal(v,'_'));
+    }else {
+        m = _mm256_andnot_si256(_mm256_or_si256(equal(v,'"'),equal(v,'\0')),_mm256_set1_epi8(-1));
+    }
+    return _mm256_movemask_epi8(m);
+}
+#endif
+
+
+// the run in 16-byte blocks, then byte by byte
+template<run k>
+static size_t narrowRun(const char *p,size_t n) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for(; i + 16 <= n; i += 16) {
+        uint32_t stop = ~matches<k>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i))) & 0xffff;
+        if(stop) return i + std::countr_zero(stop);
+    }
+#endif
+    while(i < n && continues<k>(p[i])) i++;
+    return i;
+}
+
+
+#ifdef __SSE2__
+template<run k>
+[[gnu::target("avx2")]] static size_t wideRun(const char *p,size_t n) {
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32) {
+        uint32_t stop = ~matches<k>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)));
+        if(stop) return i + std::countr_zero(stop);
+    }
+    return i + narrowRun<k>(p + i,n - i);
+}
+#endif
+
+
+// how far the run of kind k goes from p, within the n bytes left
+template<run k>
+static size_t runLength(const char *p,size_t n,bool wide) {
+    // most runs of blanks between tokens are empty
+    if(n == 0 || !continues<k>(p[0])) return 0;
+#ifdef __SSE2__
+    if(wide) return wideRun<k>(p,n);
+#else
+    (void)wide;
+#endif
+    return narrowRun<k>(p,n);
+}
+
+
+bool lexer::hasAvx2() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+
 void lexer::error_at(int start,int hintlen,std::string_view errmsg) {
     std::cerr << std::format("error:{}\n",src);
     std::cerr << std::format("{}{} {}\n",std::string(start+6,' '),std::string(hintlen,'^'),errmsg);
@@ -17,20 +217,20 @@ void lexer::error_at(int start,int hintlen,std::string_view errmsg) {
 }
 
 token lexer::identifier() {
-    while(is_identifier(peek()) || is_number(peek())) advance();
-    
-    tokenType type = tokenType::T_identifier;
-    const std::string& str = src.substr(start,cur-start);
-    auto it = keywords.find(str);
-    if(it != keywords.end()) {
-        type = it->second;
+    cur += runLength<run::R_ident>(src.data() + cur,src.size() - cur,wide);
+
+    std::string_view str = src.substr(start,cur-start);
+    tokenType type = keywordType(str);
+    if(type != tokenType::T_identifier) {
+        return token(0,start,str,type);
     }
-    return token(0,start,src.substr(start,cur-start),type);
+    int id = ids.try_emplace(str,ids.size()).first->second;
+    return token(0,start,str,tokenType::T_identifier,id);
 }
 
 token lexer::string() {
     advance();
-    while(!is_eof(peek()) && !is_string(peek())) advance();
+    cur += runLength<run::R_string>(src.data() + cur,src.size() - cur,wide);
     if(is_eof(peek())) {
         error_at(start,cur-start,"expect \"");
     }
@@ -113,6 +313,7 @@ token lexer::bracket() {
         case '}': type = tokenType::T_close_block;break;
         case '[': type = tokenType::T_open_square;break;
         case ']': type = tokenType::T_close_square;break;
+        default: error_at(start,1,std::format("unexpected character:{}",peek()));
     }
     advance();
     return token(0,start,src.substr(start,cur-start),type);
@@ -125,6 +326,7 @@ token lexer::puct() {
         case ';': type = tokenType::T_semicolon;break;
         case '.': type = tokenType::T_period;break;
         case '&': type = tokenType::T_addr;break;
+        default: error_at(start,1,std::format("unexpected character:{}",peek()));
     }
     advance();
     return token(0,start,src.substr(start,1),type);
@@ -136,23 +338,23 @@ token lexer::eof() {
 
 token lexer::newToken() {
     skip_blank();
-    char c = peek();
     start = cur;
-
-    if(is_number(c))     return number(); 
-    if(is_identifier(c)) return identifier(); 
-    if(is_string(c))     return string();
-    if(is_bracket(c))    return bracket(); 
-    if(is_eof(c))        return eof(); 
-    if(is_operator(c))   return operator_sign(); 
-    if(is_puct(c))       return puct(); 
+    switch(classOf(peek())) {
+        case charClass::C_digit:    return number();
+        case charClass::C_ident:    return identifier();
+        case charClass::C_quote:    return string();
+        case charClass::C_bracket:  return bracket();
+        case charClass::C_eof:      return eof();
+        case charClass::C_operator: return operator_sign();
+        case charClass::C_puct:     return puct();
+        default:break;
+    }
     error_at(start,1,std::format("unrecongenized character:{}",peek()));
 }
 
 
-bool lexer::iskeyword(const std::string& name) {
-    auto it = keywords.find(name);
-    return it != keywords.end();
+bool lexer::iskeyword(std::string_view name) {
+    return keywordType(name) != tokenType::T_identifier;
 }
 
 void lexer::advance() {
@@ -169,6 +371,6 @@ char lexer::peeknext() {
 
 
 void lexer::skip_blank() {
-    while(is_blank(peek())) advance();
+    cur += runLength<run::R_blank>(src.data() + cur,src.size() - cur,wide);
 }
 
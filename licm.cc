@@ -0,0 +1,86 @@
+#include "include/licm.h"
+
+
+/*
+ * arithmetic always qualifies. a division only by a constant it cannot trap
+ * on, and a load only when nothing in the loop writes memory and the load
+ * runs before every way out of the loop.
+ */
+bool licm::hoistable(const irInst& in,int b,const irLoop& l,bool memory,const std::vector<int>& exits)const {
+    switch(in.op) {
+        case irOp::copy:
+        case irOp::add:
+        case irOp::sub:
+        case irOp::mul:
+        case irOp::shl:
+        case irOp::sar:
+        case irOp::neg:
+        case irOp::lt:
+        case irOp::le:
+        case irOp::gt:
+        case irOp::ge:
+        case irOp::eq:
+        case irOp::ne:
+        case irOp::addr:
+            break;
+        case irOp::div:
+            if(!in.b.isImm() || in.b.v == 0 || in.b.v == -1) return false;
+            break;
+        case irOp::load:
+            if(memory) return false;
+            for(int e : exits) {
+                if(!form.dominates(b,e)) return false;
+            }
+            break;
+        default:
+            return false;
+    }
+    bool inside = false;
+    in.forUses([&](int r) { inside |= defblock[r] >= 0 && l.contains(defblock[r]); });
+    return !inside;
+}
+
+
+void licm::hoist(const irLoop& l) {
+    bool memory = false;
+    std::vector<int> exits;
+    for(size_t b = 0; b < func.blocks.size(); b++) {
+        if(!l.contains(b)) continue;
+        auto &blk = func.blocks[b];
+        for(auto &in : blk.insts) {
+            memory |= in.writesMemory();
+        }
+        bool exiting = blk.terminator().op == irOp::ret;
+        for(int s : blk.succs) exiting |= !l.contains(s);
+        if(exiting) exits.push_back(b);
+    }
+
+    // in reverse postorder an operand is hoisted before what reads it
+    auto &pre = func.blocks[l.preheader].insts;
+    for(int b : form.rpo()) {
+        if(!l.contains(b)) continue;
+        auto &insts = func.blocks[b].insts;
+        for(size_t i = 0; i < insts.size();) {
+            if(!hoistable(insts[i],b,l,memory,exits)) {
+                i++;
+                continue;
+            }
+            defblock[insts[i].dst] = l.preheader;
+            pre.insert(pre.end() - 1,std::move(insts[i]));
+            insts.erase(insts.begin() + i);
+        }
+    }
+}
+
+
+void licm::run() {
+    loopinfo info(func,form);
+    info.analyze();
+    defblock.assign(func.nregs,-1);
+    for(size_t b = 0; b < func.blocks.size(); b++) {
+        for(auto &in : func.blocks[b].insts) {
+            if(in.dst >= 0) defblock[in.dst] = b;
+        }
+    }
+    for(auto &l : info.loops()) hoist(l);
+}
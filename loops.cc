@@ -0,0 +1,201 @@
+#include "include/loops.h"
+
+#include <algorithm>
+
+
+void loopinfo::find() {
+    _loops.clear();
+    size_t n = func.blocks.size();
+    for(int t : form.rpo()) {
+        for(int h : func.blocks[t].succs) {
+            // the entry holds the parameters and cannot be re-entered
+            if(h == 0 || !form.dominates(h,t)) continue;
+            auto it = std::find_if(_loops.begin(),_loops.end(),[&](const irLoop& l) { return l.header == h; });
+            if(it == _loops.end()) {
+                irLoop l;
+                l.header = h;
+                l.body.assign(n,false);
+                l.body[h] = true;
+                l.size = 1;
+                _loops.push_back(std::move(l));
+                it = _loops.end() - 1;
+            }
+            it->latches.push_back(t);
+            std::vector<int> work{t};
+            while(!work.empty()) {
+                int b = work.back();
+                work.pop_back();
+                if(it->body[b]) continue;
+                it->body[b] = true;
+                it->size++;
+                for(int p : func.blocks[b].preds) work.push_back(p);
+            }
+        }
+    }
+    for(auto &l : _loops) {
+        std::vector<int> outside;
+        for(int p : func.blocks[l.header].preds) {
+            if(!l.contains(p)) outside.push_back(p);
+        }
+        if(outside.size() == 1 && func.blocks[outside[0]].succs.size() == 1) l.preheader = outside[0];
+    }
+    std::stable_sort(_loops.begin(),_loops.end(),[](const irLoop& a,const irLoop& b) { return a.size < b.size; });
+}
+
+
+/*
+ * a new block placed before the header takes over the edges entering the
+ * loop; when several enter, the header's phis split in two.
+ */
+void loopinfo::addPreheader(const irLoop& l) {
+    auto &blocks = func.blocks;
+    int h = l.header,pre = blocks.size();
+    std::vector<int> outside;
+    for(int p : blocks[h].preds) {
+        if(!l.contains(p)) outside.push_back(p);
+    }
+    irBlock b;
+    b.insts.push_back({irOp::jmp});
+    b.succs = {h};
+    for(auto &in : blocks[h].insts) {
+        if(in.op != irOp::phi) break;
+        if(outside.size() == 1) {
+            *std::find(in.incoming.begin(),in.incoming.end(),outside[0]) = pre;
+            continue;
+        }
+        irInst phi{irOp::phi,func.newReg()};
+        for(size_t k = 0; k < in.incoming.size();) {
+            if(l.contains(in.incoming[k])) {
+                k++;
+                continue;
+            }
+            phi.args.push_back(in.args[k]);
+            phi.incoming.push_back(in.incoming[k]);
+            in.args.erase(in.args.begin() + k);
+            in.incoming.erase(in.incoming.begin() + k);
+        }
+        in.args.push_back(irVal::reg(phi.dst));
+        in.incoming.push_back(pre);
+        b.insts.insert(b.insts.end() - 1,std::move(phi));
+    }
+    for(int p : outside) {
+        for(int &s : blocks[p].succs) {
+            if(s == h) s = pre;
+        }
+    }
+    blocks.push_back(std::move(b));
+
+    std::vector<int> index(blocks.size());
+    for(int i = 0,k = 0; i < pre; i++) {
+        if(i == h) index[pre] = k++;
+        index[i] = k++;
+    }
+    func.renumber(index);
+}
+
+
+void loopinfo::analyze() {
+    form.computeDominators();
+    find();
+    for(;;) {
+        auto it = std::find_if(_loops.begin(),_loops.end(),[](const irLoop& l) { return l.preheader < 0; });
+        if(it == _loops.end()) break;
+        addPreheader(*it);
+        form.computeDominators();
+        find();
+    }
+}
+
+
+int64_t wrapAdd(int64_t a,int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+
+
+int64_t wrapMul(int64_t a,int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));
+}
+
+
+static int log2(int64_t n) {
+    if(n <= 0 || (n & (n - 1)) != 0) return -1;
+    return __builtin_ctzll(n);
+}
+
+
+void loopvalues::locate() {
+    defblock.assign(func.nregs,-1);
+    defs.assign(func.nregs,nullptr);
+    for(size_t b = 0; b < func.blocks.size(); b++) {
+        for(auto &in : func.blocks[b].insts) {
+            if(in.dst < 0) continue;
+            defblock[in.dst] = b;
+            defs[in.dst] = &in;
+        }
+    }
+}
+
+
+bool loopvalues::invariant(const irVal& v,const irLoop& l)const {
+    if(v.isImm()) return true;
+    return v.isReg() && defblock[v.v] >= 0 && !l.contains(defblock[v.v]);
+}
+
+
+// the form of what in computes in l, from the forms of its operands
+affine loopvalues::follow(const irInst& in,affine fa,affine fb,const irLoop& l)const {
+    switch(in.op) {
+        case irOp::add: {
+            irVal y = in.b;
+            if(fa.iv < 0) {
+                std::swap(fa,fb);
+                y = in.a;
+            }
+            if(fa.iv < 0) return {};
+            if(fb.iv == fa.iv) {
+                if(!fa.base.isNone() && !fb.base.isNone()) return {};
+                return {fa.iv,wrapAdd(fa.m,fb.m),fa.base.isNone() ? fb.base : fa.base,wrapAdd(fa.k,fb.k)};
+            }
+            if(fb.iv >= 0 || !invariant(y,l)) return {};
+            if(y.isImm()) fa.k = wrapAdd(fa.k,y.v);
+            else if(fa.base.isNone()) fa.base = y;
+            else return {};
+            return fa;
+        }
+        case irOp::sub:
+            if(fa.iv < 0 || !in.b.isImm()) return {};
+            fa.k = wrapAdd(fa.k,-static_cast<uint64_t>(in.b.v));
+            return fa;
+        case irOp::shl:
+            if(fa.iv < 0 || !fa.base.isNone() || !in.b.isImm() || in.b.v < 0 || in.b.v > 62) return {};
+            return {fa.iv,wrapMul(fa.m,int64_t(1) << in.b.v),{},wrapMul(fa.k,int64_t(1) << in.b.v)};
+        case irOp::mul: {
+            irVal c = in.b;
+            if(fa.iv < 0) {
+                fa = fb;
+                c = in.a;
+            }
+            if(fa.iv < 0 || !fa.base.isNone() || !c.isImm()) return {};
+            return {fa.iv,wrapMul(fa.m,c.v),{},wrapMul(fa.k,c.v)};
+        }
+        default:
+            return {};
+    }
+}
+
+
+// op on a and b appended to insts, or its value when that is known already
+irVal loopvalues::emit(std::vector<irInst>& insts,irOp op,const irVal& a,const irVal& b) {
+    if(a.isImm() && b.isImm()) {
+        if(op == irOp::add) return irVal::imm(wrapAdd(a.v,b.v));
+        if(op == irOp::sub) return irVal::imm(wrapAdd(a.v,-static_cast<uint64_t>(b.v)));
+        if(op == irOp::mul) return irVal::imm(wrapMul(a.v,b.v));
+    }
+    if((op == irOp::add || op == irOp::sub) && b.isImm() && b.v == 0) return a;
+    if(op == irOp::add && a.isImm() && a.v == 0) return b;
+    if(op == irOp::mul && b.isImm() && b.v == 1) return a;
+    if(op == irOp::mul && b.isImm() && log2(b.v) > 0) return emit(insts,irOp::shl,a,irVal::imm(log2(b.v)));
+    int r = func.newReg();
+    insts.push_back({op,r,a,b});
+    return irVal::reg(r);
+}
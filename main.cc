@@ -1,16 +1,138 @@
 #include <iostream>
 #include <string>
+#include <string_view>
+#include "include/assembler.h"
 #include "include/codegenerator.h"
+#include "include/elfwriter.h"
+#include "include/emitter.h"
+#include "include/gvn.h"
+#include "include/inliner.h"
+#include "include/irgen.h"
+#include "include/ivopt.h"
+#include "include/jit.h"
 #include "include/lexer.h"
+#include "include/licm.h"
+#include "include/peephole.h"
+#include "include/ssa.h"
+#include "include/tailcall.h"
+#include "include/vectorizer.h"
 
 int main(int argc,char *argv[]) {
-    if(argc < 2){
-        std::cerr << "usage:./wizardc [input]";
+    const char *src = nullptr;
+    const char *output = nullptr;
+    bool emit_ir = false;
+    bool object = false;
+    bool run = false;
+    bool peephole_stats = false;
+    bool omit_frame_pointer = false;
+    bool optimize = true;
+    bool vectorize = true;
+    bool avx2 = false;
+    int inline_limit = inliner::defaultLimit;
+    for(int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if(arg == "-o") {
+            if(++i == argc) {
+                std::cerr << "wizardc: '-o' requires a file name\n";
+                exit(-1);
+            }
+            output = argv[i];
+        }else if(arg == "--run") {
+            run = true;
+        }else if(arg == "-c") {
+            object = true;
+        }else if(arg == "--emit-ir") {
+            emit_ir = true;
+        }else if(arg == "--peephole-stats") {
+            peephole_stats = true;
+        }else if(arg == "-fomit-frame-pointer") {
+            omit_frame_pointer = true;
+        }else if(arg == "-O0") {
+            optimize = false;
+        }else if(arg == "-mavx2") {
+            avx2 = true;
+        }else if(arg == "-fno-vectorize") {
+            vectorize = false;
+        }else if(arg.starts_with("-finline-limit=")) {
+            inline_limit = std::atoi(argv[i] + arg.find('=') + 1);
+        }else if(src == nullptr) {
+            src = argv[i];
+        }
+    }
+    if(src == nullptr){
+        std::cerr << "usage:./wizardc [input] [-c] [-o output] [--run] [--emit-ir] [--peephole-stats] [-fomit-frame-pointer] [-finline-limit=n] [-O0] [-mavx2] [-fno-vectorize]";
+        exit(-1);
+    }
+    if(object && output == nullptr) {
+        std::cerr << "wizardc: '-c' requires '-o file.o'\n";
         exit(-1);
     }
-    Parser parser(argv[1]);
+    Parser parser(src);
     Prog prog = parser.start();
-    codegenerator gen;
-    prog.accept(gen);
+    irModule mod;
+    irgenerator lower(mod);
+    prog.accept(lower);
+    // --emit-ir shows the functions still in SSA form
+    if(optimize) {
+        // callees are cleaned up before they get inlined anywhere
+        inliner inl(mod,inline_limit);
+        for(int i : inl.bottomUp()) {
+            auto &f = mod.funcs[i];
+            tailcall(mod).run(f);
+            ssa s(f);
+            s.construct();
+            s.eliminateDeadCode();
+            if(inl.run(f)) s.eliminateDeadCode();
+        }
+        for(auto &f : mod.funcs) {
+            ssa s(f);
+            gvn(f,s).run();
+            licm(f,s).run();
+            if(vectorize) vectorizer(f,s,avx2 ? 32 : 16).run();
+            ivopt(f,s).run();
+            // what strength reduction left behind in the preheaders
+            gvn(f,s).run();
+            if(!emit_ir) s.destruct();
+        }
+    }
+
+    bool ok;
+    if(emit_ir) {
+        std::string buf;
+        mod.dump(buf);
+        FILE *fp = output ? std::fopen(output,"w") : stdout;
+        ok = fp && std::fwrite(buf.data(),1,buf.size(),fp) == buf.size();
+        if(fp && output) ok = std::fclose(fp) == 0 && ok;
+    }else {
+        emitter emit;
+        codegenerator gen(emit,omit_frame_pointer);
+        gen.gen(mod);
+        peephole opt(emit);
+        opt.run();
+        if(peephole_stats) opt.report(std::cerr);
+        if(object || run) {
+            assembler as(emit);
+            if(!as.run()) {
+                std::cerr << std::format("wizardc: {}\n",as.error());
+                exit(-1);
+            }
+            if(run) {
+                jit j(as);
+                int status;
+                if(!j.load() || !j.run(status)) {
+                    std::cerr << std::format("wizardc: {}\n",j.error());
+                    exit(-1);
+                }
+                return status;
+            }
+            ok = elfwriter(as).write(output);
+        }else {
+            ok = emit.write(output);
+        }
+    }
+    if(!ok) {
+        std::cerr << std::format("wizardc: cannot write '{}'\n",output ? output : "stdout");
+        exit(-1);
+    }
     return 0;
 }
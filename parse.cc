@@ -1,6 +1,6 @@
 #include "include/parse.h"
 
-std::vector<std::shared_ptr<Stmt>> global_def;
+std::vector<Stmt*> global_def;
 #ifdef DEBUG
 std::map<tokenType,std::string> tokenstrs {
     {tokenType::T_num,"T_num"},
@@ -38,23 +38,35 @@ std::map<tokenType,std::string> tokenstrs {
 };
 #endif
 
-std::map<tokenType,precType> precedence {
-    { tokenType::T_num,precType::P_none },
-    { tokenType::T_eof,precType::P_none },
-    { tokenType::T_identifier,precType::P_none },
-    { tokenType::T_bit_and,precType::P_bit },
-    { tokenType::T_plus,precType::P_factor },
-    { tokenType::T_minus,precType::P_factor },
-    { tokenType::T_star,precType::P_term },
-    { tokenType::T_div,precType::P_term },
-    { tokenType::T_assign,precType::P_assign },
-    { tokenType::T_lt,precType::P_comparison },
-    { tokenType::T_le,precType::P_comparison },
-    { tokenType::T_gt,precType::P_comparison },
-    { tokenType::T_ge,precType::P_comparison },
-    { tokenType::T_neq,precType::P_comparison },
-    { tokenType::T_eq,precType::P_comparison },
-};
+constexpr Parser::ruleTable Parser::rules = [] {
+    ruleTable r{};
+    auto at = [&](tokenType t) -> rule& { return r[static_cast<size_t>(t)]; };
+    at(tokenType::T_num).prefix = &Parser::parse_numeric;
+    at(tokenType::T_identifier).prefix = &Parser::parse_ident;
+    at(tokenType::T_string).prefix = &Parser::parse_string;
+    at(tokenType::T_minus).prefix = &Parser::parse_prefix;
+    at(tokenType::T_star).prefix = &Parser::parse_prefix;
+    at(tokenType::T_addr).prefix = &Parser::parse_prefix;
+    at(tokenType::T_open_paren).prefix = &Parser::parse_group_expr;
+
+    auto binary = [&](tokenType t,precType prec) {
+        at(t).infix = &Parser::parse_binary_expr;
+        at(t).prec = prec;
+    };
+    binary(tokenType::T_assign,precType::P_assign);
+    binary(tokenType::T_lt,precType::P_comparison);
+    binary(tokenType::T_le,precType::P_comparison);
+    binary(tokenType::T_gt,precType::P_comparison);
+    binary(tokenType::T_ge,precType::P_comparison);
+    binary(tokenType::T_neq,precType::P_comparison);
+    binary(tokenType::T_eq,precType::P_comparison);
+    binary(tokenType::T_bit_and,precType::P_bit);
+    binary(tokenType::T_plus,precType::P_factor);
+    binary(tokenType::T_minus,precType::P_factor);
+    binary(tokenType::T_star,precType::P_term);
+    binary(tokenType::T_div,precType::P_term);
+    return r;
+}();
 
 
 void Parser::error(const token& t,std::string_view msg){
@@ -78,7 +90,7 @@ bool Parser::tkequal(tokenType expect) {
 
 
 void Parser::tkexpect(tokenType expect,const std::string& msg) {
-    if(tokens[cur].type != expect) {
+    if(curToken().type != expect) {
         error(curToken(),msg);
     }
 }
@@ -92,42 +104,33 @@ bool Parser::tkconsume(tokenType expect) {
 }
 
 
-precType get_precedence(tokenType t) {
-    auto it = precedence.find(t);
-    if(it != precedence.end()) {
-        return it->second;
-    }
-    return precType::P_none;
-}
-
-
 Parser::prefixcall Parser::get_prefix_call(tokenType t) {
-    auto it = prefixcalls.find(t);
-    if(it == prefixcalls.end()) {
-        if(tokens[prev].type == tokenType::T_eof){
+    prefixcall call = rules[static_cast<size_t>(t)].prefix;
+    if(!call) {
+        if(prevToken().type == tokenType::T_eof){
             error(prevToken(),"expect a expression");
         }else{
             error(prevToken(),std::format("invalid prefix '{}'",prevToken().str));
         }
     }
-    return it->second;
+    return call;
 }
 
 
 Parser::infixcall Parser::get_infix_call(tokenType t) {
-    auto it = infixcalls.find(t);
-    if(it == infixcalls.end()) {
-        if(tokens[prev].type == tokenType::T_eof){
+    infixcall call = rules[static_cast<size_t>(t)].infix;
+    if(!call) {
+        if(prevToken().type == tokenType::T_eof){
             error(prevToken(),"expect a expression");
         }else{
             error(prevToken(),std::format("invalid infix '{}'",prevToken().str));
         }
     }
-    return it->second;
+    return call;
 }
 
 
-std::shared_ptr<Type> Parser::pointerPrefix(std::shared_ptr<Type> base) {
+Type *Parser::pointerPrefix(Type *base) {
     while(tkconsume(tokenType::T_star)) {
         base = typeFactor::getPointerType(base);
     }
@@ -135,8 +138,8 @@ std::shared_ptr<Type> Parser::pointerPrefix(std::shared_ptr<Type> base) {
 }
 
 
-std::shared_ptr<Type> Parser::declspec() {
-    std::shared_ptr<Type> type;
+Type *Parser::declspec() {
+    Type *type = nullptr;
     if(tkequal(tokenType::T_int)) {
         type = typeFactor::getInt();
     }else if(tkequal(tokenType::T_char)) {
@@ -149,46 +152,49 @@ std::shared_ptr<Type> Parser::declspec() {
 }
 
 
-std::shared_ptr<Type> Parser::declType() {
-    std::shared_ptr<Type> base = declspec();
+Type *Parser::declType() {
+    Type *base = declspec();
     base = pointerPrefix(base);
     return base;
 }
 
 
-std::shared_ptr<Node> Parser::parse_numeric() {
-    return std::make_shared<numericNode>(prevToken().val,prevToken());
+Node *Parser::parse_numeric() {
+    return nodes.make<numericNode>(prevToken().val,prevToken());
 }
 
-std::shared_ptr<Node> Parser::parse_string() {
-    std::shared_ptr<Node> str_node = std::make_shared<stringNode>(prevToken());
-    std::vector<std::shared_ptr<Node>> decls{str_node};
-    global_def.push_back(std::make_shared<vardef>(decls,true));
+// a literal spelled like an earlier one shares its storage
+Node *Parser::parse_string() {
+    auto [it,added] = strings.try_emplace(prevToken().str,strings.size());
+    auto str_node = nodes.make<stringNode>(prevToken(),it->second);
+    if(added) {
+        std::vector<Node*> decls{str_node};
+        global_def.push_back(nodes.make<vardef>(nodes.copy(decls),true));
+    }
     return str_node;
 }
 
 
-std::shared_ptr<Node> Parser::identifier() {
-    const std::string& str = prevToken().str;
-    auto result = sTable.lookup(str);
-    if(!result.has_value()) {
+Node *Parser::identifier() {
+    std::string_view str = prevToken().str;
+    auto info = sTable.lookup(prevToken().id);
+    if(!info) {
         error(prevToken(),std::format("'{}' undeclared",str));
     }
-    return std::make_shared<identNode>(result.value());
+    return nodes.make<identNode>(info);
 }
 
 
-std::shared_ptr<Node> Parser::funcall() {
+Node *Parser::funcall() {
     token tok = prevToken();
-    const std::string& name = tok.str;
-    auto result = sTable.lookup(name);
-    if(!result.has_value()) {
+    std::string_view name = tok.str;
+    auto info = sTable.lookup(tok.id);
+    if(!info) {
         error(tok,std::format("function '{}' not found",name));
     }
-    const auto& info = result.value();
-    auto param_types = static_cast<funcType*>(info._type.get())->getParamTypes();
+    auto &param_types = static_cast<funcType*>(info->_type)->getParamTypes();
 
-    std::vector<std::shared_ptr<Node>> args;
+    std::vector<Node*> args;
     tokenMove();
     size_t i = 0;
     while(!tkconsume(tokenType::T_close_paren)) {
@@ -208,30 +214,29 @@ std::shared_ptr<Node> Parser::funcall() {
             error(args[j]->strStart(),args[j]->strLength(),std::format("parameter expected '{}' but argument has '{}'",param_types[j]->typestr(),msg));
         }
     }
-    auto retTy = static_cast<funcType*>(info._type.get())->getRetType();
-    return std::make_shared<funcallNode>(tok,args,SymbolInfo(tok,0,true,retTy,SymbolType::S_func));
+    auto retTy = static_cast<funcType*>(info->_type)->getRetType();
+    return nodes.make<funcallNode>(tok,nodes.copy(args),sTable.newSymbol(tok,0,true,retTy,SymbolType::S_func));
 }
 
 
-std::shared_ptr<Node> Parser::arrayvisit() {
-    const std::string& name = prevToken().str;
-    auto result = sTable.lookup(name);
-    if(!result.has_value()) {
+Node *Parser::arrayvisit() {
+    std::string_view name = prevToken().str;
+    auto info = sTable.lookup(prevToken().id);
+    if(!info) {
         error(prevToken(),std::format("'{}' not found",name));
     }
-    const auto& info = result.value();
-    auto ty = info._type;
+    auto ty = info->_type;
     if(!Type::isArray(ty) && !Type::isPointer(ty)) {
         error(prevToken(),"subscripted value is neither array nor pointer\n");
     }
     tokenMove();
-    std::shared_ptr<Node> idx = parse_expr(precType::P_none);
+    Node *idx = parse_expr(precType::P_none);
     tkskip(tokenType::T_close_square,"expect ']'");
-    return std::make_shared<arrayVisit>(info,idx);
+    return nodes.make<arrayVisit>(info,idx);
 }
 
 
-std::shared_ptr<Node> Parser::parse_ident() {
+Node *Parser::parse_ident() {
     if(tkequal(tokenType::T_open_paren)) {
         return funcall();
     }else if(tkequal(tokenType::T_open_square)) {
@@ -241,18 +246,20 @@ std::shared_ptr<Node> Parser::parse_ident() {
 }
 
 
-std::shared_ptr<Node> Parser::parse_prefix() {
+Node *Parser::parse_prefix() {
     token prefix = prevToken();
     int start = curToken().start;
     Node::Kind kind;
-    std::shared_ptr<Node> expr = parse_expr(precType::P_prefix);
+    Node *expr = parse_expr(precType::P_prefix);
 
     if(prefix.type == tokenType::T_addr) {
         if(!expr->equal(Node::Kind::N_identifier) && !expr->equal(Node::Kind::N_arrayvisit)) {
             error(prefix,"'&' requires a lvalue");
         }
         kind = Node::Kind::N_addr;
-        return std::make_shared<prefixNode>(expr,typeFactor::getPointerType(expr->getType()),kind,prefix);
+        if(expr->equal(Node::Kind::N_identifier) && !static_cast<identNode*>(expr)->isGlobal())
+            funcdef::addressTaken(static_cast<identNode*>(expr)->getOffset());
+        return nodes.make<prefixNode>(expr,typeFactor::getPointerType(expr->getType()),kind,prefix);
     }
     else if(prefix.type == tokenType::T_star) {
         kind = Node::Kind::N_deref;
@@ -262,84 +269,164 @@ std::shared_ptr<Node> Parser::parse_prefix() {
             error(start,expr->strLength(),"'*' reqiures  argument of pointer type");
         }
         if(is_array){
-            auto elem_ty = static_cast<arrayType*>(expr->getType().get())->elemTy();
-            return std::make_shared<prefixNode>(expr,elem_ty,kind,prefix);
+            auto elem_ty = static_cast<arrayType*>(expr->getType())->elemTy();
+            return nodes.make<prefixNode>(expr,elem_ty,kind,prefix);
         }else{
-            auto base = static_cast<pointerType*>(expr->getType().get())->getBaseType();
-            return std::make_shared<prefixNode>(expr,base,kind,prefix);
+            auto base = static_cast<pointerType*>(expr->getType())->getBaseType();
+            return nodes.make<prefixNode>(expr,base,kind,prefix);
         }
     }else{
-        return std::make_shared<prefixNode>(expr,expr->getType(),Node::Kind::N_trivial,prefix);
+        if(expr->equal(Node::Kind::N_number)) {
+            uint64_t v = static_cast<numericNode*>(expr)->Value();
+            return nodes.make<numericNode>(static_cast<int64_t>(0 - v),prefix);
+        }
+        return nodes.make<prefixNode>(expr,expr->getType(),Node::Kind::N_trivial,prefix);
+    }
+}
+
+
+// an expression that can be dropped without changing what the program does
+static bool side_effect_free(const Node& node) {
+    if(node.equal(Node::Kind::N_funcall)) return false;
+    if(node.equal(Node::Kind::N_binary)) {
+        auto &bin = static_cast<const binaryNode&>(node);
+        return bin.getOp() != tokenType::T_assign && side_effect_free(*bin.getLhs()) && side_effect_free(*bin.getRhs());
+    }
+    if(node.equal(Node::Kind::N_arrayvisit))
+        return side_effect_free(*static_cast<const arrayVisit&>(node).get_idx());
+    if(node.equal(Node::Kind::N_deref) || node.equal(Node::Kind::N_addr) || node.equal(Node::Kind::N_trivial))
+        return side_effect_free(*static_cast<const prefixNode&>(node).getNode());
+    return true;
+}
+
+
+/*
+ * builds 'lhs op rhs', evaluating it right away when both operands are
+ * constants and dropping the operations that leave the other operand
+ * unchanged (x+0,x-0,x*1,x/1,x*0). arithmetic wraps like the generated code.
+ */
+Node *Parser::fold(const token& op,Node *lhs,Node *rhs,Type *type) {
+    bool lconst = lhs->equal(Node::Kind::N_number);
+    bool rconst = rhs->equal(Node::Kind::N_number);
+    int64_t l = lconst ? static_cast<numericNode*>(lhs)->Value() : 0;
+    int64_t r = rconst ? static_cast<numericNode*>(rhs)->Value() : 0;
+    if(lconst && rconst) {
+        uint64_t ul = l,ur = r;
+        std::optional<int64_t> v;
+        switch(op.type) {
+            case tokenType::T_plus:  v = static_cast<int64_t>(ul + ur);break;
+            case tokenType::T_minus: v = static_cast<int64_t>(ul - ur);break;
+            case tokenType::T_star:  v = static_cast<int64_t>(ul * ur);break;
+            case tokenType::T_div:
+                if(r != 0 && !(l == INT64_MIN && r == -1)) v = l / r;
+                break;
+            case tokenType::T_lt:    v = l < r;break;
+            case tokenType::T_le:    v = l <= r;break;
+            case tokenType::T_gt:    v = l > r;break;
+            case tokenType::T_ge:    v = l >= r;break;
+            case tokenType::T_eq:    v = l == r;break;
+            case tokenType::T_neq:   v = l != r;break;
+            default:break;
+        }
+        if(v.has_value()) return nodes.make<numericNode>(v.value(),op);
+    }
+    // the surviving operand must already have the type of the whole expression
+    auto keeps = [&](const Node *n) {
+        auto ty = n->getType();
+        return !Type::isArray(ty) && (ty == type || (Type::isInteger(ty) && Type::isInteger(type)));
+    };
+    switch(op.type) {
+        case tokenType::T_plus:
+            if(rconst && r == 0 && keeps(lhs)) return lhs;
+            if(lconst && l == 0 && keeps(rhs)) return rhs;
+            break;
+        case tokenType::T_minus:
+            if(rconst && r == 0 && keeps(lhs)) return lhs;
+            break;
+        case tokenType::T_star:
+            if(rconst && r == 1 && keeps(lhs)) return lhs;
+            if(lconst && l == 1 && keeps(rhs)) return rhs;
+            if(rconst && r == 0 && side_effect_free(*lhs)) return rhs;
+            if(lconst && l == 0 && side_effect_free(*rhs)) return lhs;
+            break;
+        case tokenType::T_div:
+            if(rconst && r == 1 && keeps(lhs)) return lhs;
+            break;
+        default:break;
     }
+    return nodes.make<binaryNode>(op,lhs,rhs,type);
 }
 
 
-std::shared_ptr<Node> Parser::parse_group_expr() {
-    std::shared_ptr<Node> e = parse_expr(precType::P_none);
+Node *Parser::parse_group_expr() {
+    Node *e = parse_expr(precType::P_none);
     tkskip(tokenType::T_close_paren,"expect ')'");
     return e;
 }
 
 
-std::shared_ptr<Node> Parser::ptr_add(token& op,std::shared_ptr<Node> lhs,std::shared_ptr<Node> rhs) {
+Node *Parser::ptr_add(token& op,Node *lhs,Node *rhs) {
     if(Type::isInteger(lhs->getType()) && Type::isInteger(rhs->getType())) {
-        return std::make_shared<binaryNode>(op,lhs,rhs,lhs->getType());
+        return fold(op,lhs,rhs,lhs->getType());
     }
     if(Type::isInteger(lhs->getType())) {
         std::swap(lhs,rhs);
     }
     size_t size;
-    if(Type::isArray(lhs->getType())) size = static_cast<arrayType*>(lhs->getType().get())->elemSize();  
+    if(Type::isArray(lhs->getType())) size = static_cast<arrayType*>(lhs->getType())->elemSize();  
     else {
-        auto ptr = static_cast<pointerType*>(lhs->getType().get());
+        auto ptr = static_cast<pointerType*>(lhs->getType());
         size = ptr->getBaseType()->getSize();
     }
     op.type = tokenType::T_star;
-    std::shared_ptr<Type> type = typeFactor::getInt();
-    std::shared_ptr<Node> num_node = std::make_shared<numericNode>(size,op);
-    std::shared_ptr<Node> new_node = std::make_shared<binaryNode>(op,rhs,num_node,type);
+    Type *type = typeFactor::getInt();
+    Node *num_node = nodes.make<numericNode>(size,op);
+    Node *new_node = fold(op,rhs,num_node,type);
     op.type = tokenType::T_plus;
-    return std::make_shared<binaryNode>(op,lhs,new_node,lhs->getType());
+    return fold(op,lhs,new_node,lhs->getType());
 }
 
 
-std::shared_ptr<Node> Parser::ptr_sub(token& op,std::shared_ptr<Node> lhs,std::shared_ptr<Node> rhs) {
+Node *Parser::ptr_sub(token& op,Node *lhs,Node *rhs) {
     if(Type::isInteger(lhs->getType()) && Type::isInteger(rhs->getType())) {
-        return std::make_shared<binaryNode>(op,lhs,rhs,lhs->getType());
+        return fold(op,lhs,rhs,lhs->getType());
     }
 
     size_t size;
     if(Type::isInteger(rhs->getType())) {
-        if(Type::isArray(lhs->getType())) size = static_cast<arrayType*>(lhs->getType().get())->elemSize();
-        else size = static_cast<pointerType*>(lhs->getType().get())->getSize();
+        if(Type::isArray(lhs->getType())) size = static_cast<arrayType*>(lhs->getType())->elemSize();
+        else size = static_cast<pointerType*>(lhs->getType())->getBaseType()->getSize();
         op.type = tokenType::T_star;
-        std::shared_ptr<Type> type = typeFactor::getInt();
-        std::shared_ptr<Node> num_node = std::make_shared<numericNode>(size,op);
-        std::shared_ptr<Node> new_node = std::make_shared<binaryNode>(op,rhs,num_node,type);
+        Type *type = typeFactor::getInt();
+        Node *num_node = nodes.make<numericNode>(size,op);
+        Node *new_node = fold(op,rhs,num_node,type);
         op.type = tokenType::T_minus;
-        return std::make_shared<binaryNode>(op,lhs,new_node,lhs->getType());
+        return fold(op,lhs,new_node,lhs->getType());
     }else {
-        if(Type::isArray(lhs->getType())) size = static_cast<arrayType*>(lhs->getType().get())->elemSize();  
+        if(Type::isArray(lhs->getType())) size = static_cast<arrayType*>(lhs->getType())->elemSize();  
         else {
-            auto ptr = static_cast<pointerType*>(lhs->getType().get());
+            auto ptr = static_cast<pointerType*>(lhs->getType());
             size = ptr->getBaseType()->getSize();
         }
         op.type = tokenType::T_minus;
-        std::shared_ptr<Type> type = typeFactor::getInt();
-        std::shared_ptr<Node> minus_node = std::make_shared<binaryNode>(op,lhs,rhs,type);
-        std::shared_ptr<Node> num_node = std::make_shared<numericNode>(lhs->typeSize(),op);
+        Type *type = typeFactor::getInt();
+        Node *minus_node = nodes.make<binaryNode>(op,lhs,rhs,type);
+        Node *num_node = nodes.make<numericNode>(size,op);
         op.type = tokenType::T_div;
-        return std::make_shared<binaryNode>(op,minus_node,num_node,type);
+        Node *diff = fold(op,minus_node,num_node,type);
+        if(diff->equal(Node::Kind::N_binary) && static_cast<binaryNode*>(diff)->getOp() == tokenType::T_div)
+            static_cast<binaryNode*>(diff)->setExact();
+        return diff;
     }
 }
 
 
 
-std::shared_ptr<Node> Parser::parse_binary_expr(std::shared_ptr<Node> lhs) {
+Node *Parser::parse_binary_expr(Node *lhs) {
     token op = prevToken();
-    precType prec = get_precedence(op.type);
-    std::shared_ptr<Node> rhs = parse_expr(prec);
-    std::shared_ptr<Type> type;
+    precType prec = rules[static_cast<size_t>(op.type)].prec;
+    Node *rhs = parse_expr(prec);
+    Type *type = nullptr;
     try{
         type = typeChecker::checkBinaryOp(op.type,lhs->getType(),rhs->getType());
     }catch(const std::string& msg){
@@ -349,50 +436,52 @@ std::shared_ptr<Node> Parser::parse_binary_expr(std::shared_ptr<Node> lhs) {
         return ptr_add(op,lhs,rhs);
     }else if(op.assert(tokenType::T_minus)) {
         return ptr_sub(op,lhs,rhs);
+    }else if(op.assert(tokenType::T_assign)) {
+        return nodes.make<binaryNode>(op,lhs,rhs,type);
     }
-    return std::make_shared<binaryNode>(op,lhs,rhs,type);
+    return fold(op,lhs,rhs,type);
 }
 
 
 
-std::shared_ptr<Node> Parser::parse_expr(precType prec) {
+Node *Parser::parse_expr(precType prec) {
     tokenMove();
-    auto prefixcall = get_prefix_call(prevToken().type);
-    std::shared_ptr<Node> left = prefixcall();
-    while(!tkequal(tokenType::T_eof) && prec < get_precedence(curToken().type)) {
-        auto infixcall = get_infix_call(curToken().type);
+    prefixcall prefix = get_prefix_call(prevToken().type);
+    Node *left = (this->*prefix)();
+    while(!tkequal(tokenType::T_eof) && prec < rules[static_cast<size_t>(curToken().type)].prec) {
+        infixcall infix = get_infix_call(curToken().type);
         tokenMove();
-        left = infixcall(left);
+        left = (this->*infix)(left);
     }
     return left;
 }
 
 
-std::shared_ptr<Stmt> Parser::expr_stmt() {
+Stmt *Parser::expr_stmt() {
     if(tkconsume(tokenType::T_semicolon)) return nullptr;
-    std::shared_ptr<Node> e = parse_expr(precType::P_none);
+    Node *e = parse_expr(precType::P_none);
     tkskip(tokenType::T_semicolon,"expect ';'");
-    return std::make_shared<exprStmt>(e);
+    return nodes.make<exprStmt>(e);
 }
 
 
-std::shared_ptr<Stmt> Parser::if_stmt() {
+Stmt *Parser::if_stmt() {
     tkskip(tokenType::T_open_paren,"expect '(' after 'if' of if-statement");
     if(tkequal(tokenType::T_close_paren)) {
         error(curToken(),"expect an expression");
     }
-    std::shared_ptr<Node> _cond = parse_expr(precType::P_none);
+    Node *_cond = parse_expr(precType::P_none);
     tkskip(tokenType::T_close_paren,"expect ')' after condition");
-    std::shared_ptr<Stmt> _then = parse_stmt();
-    std::shared_ptr<Stmt> _else;
+    Stmt *_then = parse_stmt();
+    Stmt *_else = nullptr;
     if(tkequal(tokenType::T_else)) {
         tokenMove();
         _else = parse_stmt();
     }
-    return std::make_shared<ifStmt>(_cond,_then,_else);
+    return nodes.make<ifStmt>(_cond,_then,_else);
 }
 
-void Parser::keywordCheck(const token &tok,const std::string& name) {
+void Parser::keywordCheck(const token &tok,std::string_view name) {
     if(lex.iskeyword(name))
         error(tok,std::format("variable name couldn't be a keyword:'{}'",name));
 }
@@ -406,11 +495,11 @@ bool Parser::is_function() {
 }
 
 
-SymbolInfo Parser::varTypeSuffix(std::shared_ptr<Type> type,bool global) {
+const SymbolInfo *Parser::varTypeSuffix(Type *type,bool global) {
     type = pointerPrefix(type);
     token tok = curToken();
     tkskip(tokenType::T_identifier,"expect an identifier");
-    const std::string& name = tok.str;
+    std::string_view name = tok.str;
     int off = 0;
     if(is_array()) {
             tokenMove();
@@ -419,8 +508,8 @@ SymbolInfo Parser::varTypeSuffix(std::shared_ptr<Type> type,bool global) {
             tkskip(tokenType::T_close_square,"expect ']'");
             if(!global)
                 off = funcdef::newlocalVar(type->getSize() * len);
-            auto info = SymbolTable::newSymbol(tok,off,global,typeFactor::getArrayType(len,type),SymbolType::S_array);
-            sTable.addSymbol(global,name,info);
+            auto info = sTable.newSymbol(tok,off,global,typeFactor::getArrayType(len,type),SymbolType::S_array);
+            sTable.addSymbol(global,tok.id,info);
             return info;
     }
     else{
@@ -428,8 +517,8 @@ SymbolInfo Parser::varTypeSuffix(std::shared_ptr<Type> type,bool global) {
         if(!global) {
             off = funcdef::newlocalVar(type->getSize());
         }
-        auto info = SymbolTable::newSymbol(tok,off,global,type,SymbolType::S_var);
-        bool result = sTable.addSymbol(global,name,info); 
+        auto info = sTable.newSymbol(tok,off,global,type,SymbolType::S_var);
+        bool result = sTable.addSymbol(global,tok.id,info); 
         if(!result){
             error(curToken(),std::format("redefine variable: '{}'",name));
         }
@@ -438,32 +527,78 @@ SymbolInfo Parser::varTypeSuffix(std::shared_ptr<Type> type,bool global) {
 }
 
 
-std::shared_ptr<Node> Parser::var_init(const SymbolInfo& info) {
+/*
+ * the value of an expression a global can be initialized with: a number,
+ * or the address of a global or a string plus a constant offset
+ */
+std::optional<constValue> evaluate(Node& node) {
+    if(node.equal(Node::Kind::N_number)) return constValue{{},static_cast<numericNode&>(node).Value()};
+    if(node.equal(Node::Kind::N_string))
+        return constValue{static_cast<stringNode&>(node).symbol(),0};
+    // a global array stands for the address of its first element
+    if(node.equal(Node::Kind::N_identifier)) {
+        auto &ident = static_cast<identNode&>(node);
+        if(!ident.isGlobal() || !Type::isArray(ident.getType())) return std::nullopt;
+        return constValue{ident.getName(),0};
+    }
+    if(node.equal(Node::Kind::N_addr)) {
+        Node &var = *static_cast<prefixNode&>(node).getNode();
+        if(var.equal(Node::Kind::N_identifier)) {
+            auto &ident = static_cast<identNode&>(var);
+            if(!ident.isGlobal()) return std::nullopt;
+            return constValue{ident.getName(),0};
+        }
+        auto &arr = static_cast<arrayVisit&>(var);
+        auto idx = evaluate(*arr.get_idx());
+        if(!arr.isGlobal() || !arr.isArray() || !idx || !idx->sym.empty()) return std::nullopt;
+        return constValue{arr.getName(),static_cast<int64_t>(static_cast<uint64_t>(idx->v) * arr.typeSize())};
+    }
+    // pointer arithmetic, already scaled by the parser
+    if(node.equal(Node::Kind::N_binary)) {
+        auto &bin = static_cast<binaryNode&>(node);
+        auto l = evaluate(*bin.getLhs());
+        auto r = evaluate(*bin.getRhs());
+        if(!l || !r || !r->sym.empty()) return std::nullopt;
+        uint64_t ul = l->v,ur = r->v;
+        if(bin.getOp() == tokenType::T_plus) return constValue{l->sym,static_cast<int64_t>(ul + ur)};
+        if(bin.getOp() == tokenType::T_minus) return constValue{l->sym,static_cast<int64_t>(ul - ur)};
+    }
+    return std::nullopt;
+}
+
+
+// a global's initializer is data in the object file, so its values must be known
+void Parser::constantInit(Node& init) {
+    if(!evaluate(init)) error(init.strStart(),init.strLength(),"initializer element is not a compile-time constant");
+}
+
+
+Node *Parser::var_init(const SymbolInfo *info) {
     if(!tkconsume(tokenType::T_assign)) {
-        return std::make_shared<identNode>(info);
+        return nodes.make<identNode>(info);
     }
     else {
         token op = prevToken();
-        std::shared_ptr<Node> var = std::make_shared<identNode>(info);
-        std::shared_ptr<Node> value = parse_expr(precType::P_none);
+        Node *var = nodes.make<identNode>(info);
+        Node *value = parse_expr(precType::P_none);
         try{
             typeChecker::checkEqual(var->getType(),value->getType());
         }catch(std::string& msg){
             std::string var_type_s = var->getType()->typestr();
             error(op,std::format("{}",msg));
         }
-        return std::make_shared<binaryNode>(op,var,value,var->getType()); 
+        return nodes.make<binaryNode>(op,var,value,var->getType()); 
     }
 }
 
 
-std::shared_ptr<Node> Parser::array_init(const SymbolInfo& info) {
-    std::vector<std::shared_ptr<Node>> init_lst;
+Node *Parser::array_init(const SymbolInfo *info) {
+    std::vector<Node*> init_lst;
     if(tkconsume(tokenType::T_assign)) {
         tkskip(tokenType::T_open_block,"expect '{'");
         while(1) {
-            std::shared_ptr<Node> elem = parse_expr(precType::P_none);
-            auto elemty = static_cast<arrayType*>(info._type.get())->elemTy();
+            Node *elem = parse_expr(precType::P_none);
+            auto elemty = static_cast<arrayType*>(info->_type)->elemTy();
             try{
                 typeChecker::checkEqual(elem->getType(),elemty);
              } catch(std::string& msg) {
@@ -471,7 +606,7 @@ std::shared_ptr<Node> Parser::array_init(const SymbolInfo& info) {
                 std::string errmsg = std::format("array expected '{}' type for initialization,but '{}' has '{}'",array_type_s,elem->strView(),msg);
                 error(elem->strStart(),elem->strLength(),errmsg);
             }
-            init_lst.push_back(std::move(elem));
+            init_lst.push_back(elem);
             if(tkconsume(tokenType::T_comma)){
                 continue;
             }
@@ -481,27 +616,27 @@ std::shared_ptr<Node> Parser::array_init(const SymbolInfo& info) {
                 error(curToken(),"expect '}'");
             }
         }
-        size_t len = static_cast<arrayType*>(info._type.get())->getlen();
+        size_t len = static_cast<arrayType*>(info->_type)->getlen();
         if(len < init_lst.size()) {
-            error(info._tok,std::format("array initialization needs {} elements,but {} in {}",len,init_lst.size(),"{...}"));
+            error(info->_tok,std::format("array initialization needs {} elements,but {} in {}",len,init_lst.size(),"{...}"));
         }
     }
-    return std::make_shared<arraydef>(info,init_lst);
+    return nodes.make<arraydef>(info,nodes.copy(init_lst));
 }
 
 
 
 
-std::shared_ptr<Stmt> Parser::local_vars() {
-    std::shared_ptr<Type> type = declType();
-    std::vector<std::shared_ptr<Node>> vars;
+Stmt *Parser::local_vars() {
+    Type *type = declType();
+    std::vector<Node*> vars;
     bool first = true;
     while(1) {
         if(!first) {
-            if(Type::isPointer(type)) type = static_cast<pointerType*>(type.get())->getBaseType();
+            if(Type::isPointer(type)) type = static_cast<pointerType*>(type)->getBaseType();
         }
         auto info = varTypeSuffix(type,false);
-        if(info._sTy == SymbolType::S_var) {
+        if(info->_sTy == SymbolType::S_var) {
             vars.push_back(var_init(info));
         }else{
             vars.push_back(array_init(info));
@@ -516,14 +651,14 @@ std::shared_ptr<Stmt> Parser::local_vars() {
             break;
         }
     }
-    return std::make_shared<vardef>(vars,false);
+    return nodes.make<vardef>(nodes.copy(vars),false);
 }
 
 
 
-std::shared_ptr<Stmt> Parser::block_stmt() {
+Stmt *Parser::block_stmt() {
     tkskip(tokenType::T_open_block,"expect '{'");
-    std::vector<std::shared_ptr<Stmt>> stmts;
+    std::vector<Stmt*> stmts;
     while(!tkequal(tokenType::T_eof) && !tkequal(tokenType::T_close_block)) {
         if(tkequal(tokenType::T_int) || tkequal(tokenType::T_char)) {
             stmts.emplace_back(local_vars());
@@ -532,27 +667,27 @@ std::shared_ptr<Stmt> Parser::block_stmt() {
         }
     }
     tkskip(tokenType::T_close_block,"a block-statament expect '}'");
-    return std::make_shared<blockStmt>(stmts);
+    return nodes.make<blockStmt>(nodes.copy(stmts));
 }
 
 
-std::shared_ptr<Stmt> Parser::ret_stmt() {
-    std::shared_ptr<Stmt> s = expr_stmt();
-    return std::make_shared<retStmt>(s);
+Stmt *Parser::ret_stmt() {
+    Stmt *s = expr_stmt();
+    return nodes.make<retStmt>(s);
 }
 
-std::shared_ptr<Stmt> Parser::while_stmt() {
+Stmt *Parser::while_stmt() {
     tkskip(tokenType::T_open_paren,"expect '('");
-    std::shared_ptr<Node> cond = parse_expr(precType::P_none);
+    Node *cond = parse_expr(precType::P_none);
     tkskip(tokenType::T_close_paren,"expect ')'");
-    std::shared_ptr<Stmt> body;
+    Stmt *body = nullptr;
     if(!tkconsume(tokenType::T_semicolon)) {
         body = parse_stmt();
     }
-    return std::make_shared<whileStmt>(cond,body);
+    return nodes.make<whileStmt>(cond,body);
 }
 
-std::shared_ptr<Stmt> Parser::init_stmt() {
+Stmt *Parser::init_stmt() {
     if(tkequal(tokenType::T_int) || tkequal(tokenType::T_char)) {
         return local_vars();
     }
@@ -560,12 +695,12 @@ std::shared_ptr<Stmt> Parser::init_stmt() {
 }
 
 
-std::shared_ptr<Stmt> Parser::for_stmt() {
+Stmt *Parser::for_stmt() {
     tkskip(tokenType::T_open_paren,"expect '(");
-    std::shared_ptr<Stmt> init;
-    std::shared_ptr<Stmt> cond;
-    std::shared_ptr<Node> inc;
-    std::shared_ptr<Stmt> body;
+    Stmt *init = nullptr;
+    Stmt *cond = nullptr;
+    Node *inc = nullptr;
+    Stmt *body = nullptr;
     sTable.enter();
     init = init_stmt();
     cond = expr_stmt();
@@ -575,14 +710,14 @@ std::shared_ptr<Stmt> Parser::for_stmt() {
     } 
     body = parse_stmt();
     sTable.leave();
-    return std::make_shared<forStmt>(init,cond,inc,body);
+    return nodes.make<forStmt>(init,cond,inc,body);
 }
 
 
-std::shared_ptr<Stmt> Parser::parse_stmt() {
+Stmt *Parser::parse_stmt() {
     if(tkequal(tokenType::T_open_block)) {
         sTable.enter();
-        std::shared_ptr<Stmt> s = block_stmt();
+        Stmt *s = block_stmt();
         sTable.leave();
         return s;
     } 
@@ -595,52 +730,60 @@ std::shared_ptr<Stmt> Parser::parse_stmt() {
 }
 
 
-std::vector<std::shared_ptr<Node>> Parser::funcParams(
+std::vector<Node*> Parser::funcParams(
     const token& tok,
-    std::shared_ptr<Type> retType) {
+    Type *retType) {
 
     bool first = false;
-    const std::string& name = tok.str;
-    std::vector<std::shared_ptr<Node>> params;
-    std::vector<std::shared_ptr<Type>> paramTypes;
+    std::vector<Node*> params;
+    std::vector<Type*> paramTypes;
     while(!tkequal(tokenType::T_close_paren)) {
         if(first) {
             tkskip(tokenType::T_comma,"expect ','");
         }
         first = true;
         auto type = declType();
-        params.push_back(std::make_shared<identNode>(varTypeSuffix(type,false)));
-        paramTypes.push_back(std::move(type));
+        params.push_back(nodes.make<identNode>(varTypeSuffix(type,false)));
+        paramTypes.push_back(type);
     }
     tkskip(tokenType::T_close_paren,"expect ')'");
-    auto info = SymbolTable::newSymbol(tok,0,true,typeFactor::getFuncType(retType,paramTypes),SymbolType::S_func);
-    sTable.addSymbol(true,name,info);
+    auto info = sTable.newSymbol(tok,0,true,typeFactor::getFuncType(retType,paramTypes),SymbolType::S_func);
+    sTable.addSymbol(true,tok.id,info);
     return params;
 }
 
 
 
-std::shared_ptr<Stmt> Parser::decl_func(std::shared_ptr<Type> retType) {
+Stmt *Parser::decl_func(Type *retType) {
     token tok = prevToken();
     tokenMove();
     sTable.enter();
-    std::vector<std::shared_ptr<Node>> _params = funcParams(tok,retType);
-    std::shared_ptr<Stmt> body = block_stmt();
+    std::vector<Node*> _params = funcParams(tok,retType);
+    // a prototype only declares the function, e.g. one from the C library
+    if(tkconsume(tokenType::T_semicolon)) {
+        sTable.leave();
+        funcdef::stackrelease();
+        return nullptr;
+    }
+    Stmt *body = block_stmt();
     sTable.leave();
-    auto func = funcdef::newFunction(body,tok.str,_params);
+    auto func = funcdef::newFunction(nodes,body,std::string(tok.str),nodes.copy(_params));
     return func;
 }
 
 
-std::shared_ptr<Stmt> Parser::global_vars(std::shared_ptr<Type> type) {
-    std::vector<std::shared_ptr<Node>> vars;
+Stmt *Parser::global_vars(Type *type) {
+    std::vector<Node*> vars;
     while(1) {
         auto info = varTypeSuffix(type,true);
-        if(info._sTy == SymbolType::S_var) {
-            vars.push_back(std::make_shared<identNode>(info));
+        if(info->_sTy == SymbolType::S_var) {
+            auto var = var_init(info);
+            if(var->equal(Node::Kind::N_binary)) constantInit(*static_cast<binaryNode*>(var)->getRhs());
+            vars.push_back(var);
         }else {
-            std::vector<std::shared_ptr<Node>> init;
-            vars.push_back(std::make_shared<arraydef>(info,init));
+            auto def = array_init(info);
+            for(auto &init : static_cast<arraydef*>(def)->get_init_lst()) constantInit(*init);
+            vars.push_back(def);
         }
         if(tkconsume(tokenType::T_comma)){
             continue;
@@ -651,16 +794,17 @@ std::shared_ptr<Stmt> Parser::global_vars(std::shared_ptr<Type> type) {
             break;
         }
     }
-    return std::make_shared<vardef>(vars,true);
+    return nodes.make<vardef>(nodes.copy(vars),true);
 }
 
 
 Prog Parser::start() {
     while(!tkequal(tokenType::T_eof)) {
-        std::shared_ptr<Type> type = declType();
+        Type *type = declType();
         tokenMove();
         if(is_function()) {
-            global_def.push_back(decl_func(type));
+            auto func = decl_func(type);
+            if(func) global_def.push_back(func);
         }
         else {
             tokenBack();
@@ -675,7 +819,8 @@ Prog Parser::start() {
 void Parser::tokenMove() {
     prev = cur;
     cur++;
-    tokens.push_back(lex.newToken());
+    // a token stepped back over is not read again
+    if(cur == lexed) tokens[lexed++ % tokens.size()] = lex.newToken();
 #ifdef DEBUG
     std::cerr << "token: " << tokenstrs[curToken().type] <<" -> " << curToken().str << "\n";
 #endif
@@ -687,67 +832,14 @@ void Parser::tokenBack() {
 }
 
 const token& Parser::curToken() {
-    return tokens[cur];
+    return tokens[cur % tokens.size()];
 }
 
 const token &Parser::prevToken() {
-    return tokens[prev];
-}
-
-
-void Parser::setup() {
-   prefixcalls[tokenType::T_num] = [this]() { return parse_numeric(); }; 
-   prefixcalls[tokenType::T_identifier] = [this]() { return parse_ident(); }; 
-   prefixcalls[tokenType::T_string] = [this]() { return parse_string(); }; 
-   prefixcalls[tokenType::T_minus] = [this]() { return parse_prefix(); }; 
-   prefixcalls[tokenType::T_star] = [this]() { return parse_prefix(); }; 
-   prefixcalls[tokenType::T_addr] = [this]() { return parse_prefix(); }; 
-   prefixcalls[tokenType::T_open_paren] = [this]() { return parse_group_expr(); }; 
-
-   infixcalls[tokenType::T_plus] =  [this](std::shared_ptr<Node>& left) {
-     return parse_binary_expr(std::move(left)); };
-   infixcalls[tokenType::T_minus] = [this](std::shared_ptr<Node>& left) {
-     return parse_binary_expr(std::move(left)); };
-   infixcalls[tokenType::T_star] =  [this](std::shared_ptr<Node>& left) { 
-    return parse_binary_expr(std::move(left)); };
-   infixcalls[tokenType::T_div] =   [this](std::shared_ptr<Node>& left) { 
-    return parse_binary_expr(std::move(left)); };
-   infixcalls[tokenType::T_lt] =    [this](std::shared_ptr<Node>& left) {
-     return parse_binary_expr(std::move(left)); };
-   infixcalls[tokenType::T_le] =    [this](std::shared_ptr<Node>& left) {
-     return parse_binary_expr(std::move(left)); };
-   infixcalls[tokenType::T_gt] =    [this](std::shared_ptr<Node>& left) {
-     return parse_binary_expr(std::move(left)); };
-   infixcalls[tokenType::T_ge] =    [this](std::shared_ptr<Node>& left) { 
-    return parse_binary_expr(std::move(left)); };
-   infixcalls[tokenType::T_neq] =   [this](std::shared_ptr<Node>& left) {
-     return parse_binary_expr(std::move(left)); };
-   infixcalls[tokenType::T_eq] =    [this](std::shared_ptr<Node>& left) {
-     return parse_binary_expr(std::move(left)); };
-   infixcalls[tokenType::T_assign] = [this](std::shared_ptr<Node>& left) {
-     return parse_binary_expr(std::move(left)); };
-   infixcalls[tokenType::T_bit_and] = [this](std::shared_ptr<Node>& left) {
-     return parse_binary_expr(std::move(left)); };
-
-    precedence[tokenType::T_num] = precType::P_none,
-    precedence[tokenType::T_eof] = precType::P_none;
-    precedence[tokenType::T_plus] = precType::P_factor;
-    precedence[tokenType::T_minus] = precType::P_factor;
-    precedence[tokenType::T_star] = precType::P_term;
-    precedence[tokenType::T_div] = precType::P_term;
-    precedence[tokenType::T_assign] = precType::P_assign; 
-    precedence[tokenType::T_lt] = precType::P_comparison; 
-    precedence[tokenType::T_le] = precType::P_comparison; 
-    precedence[tokenType::T_gt] = precType::P_comparison; 
-    precedence[tokenType::T_ge] = precType::P_comparison; 
-    precedence[tokenType::T_neq] = precType::P_comparison; 
-    precedence[tokenType::T_eq] = precType::P_comparison;
-    precedence[tokenType::T_identifier]=precType::P_none;
-    precedence[tokenType::T_bit_and] = precType::P_bit;
-}
-
-
-Parser::Parser(const char *src):lex(src) {
-    setup();
+    return tokens[prev % tokens.size()];
+}
+
+
+Parser::Parser(const char *src):lex(src),sTable(nodes) {
     tokenMove();
 }
@@ -0,0 +1,395 @@
+#include "include/peephole.h"
+
+#include <format>
+
+// the status flags are tracked like a register, under the otherwise unused reg::none
+static constexpr reg flags = reg::none;
+
+static constexpr reg argregs[] = { reg::rdi,reg::rsi,reg::rdx,reg::rcx,reg::r8,reg::r9 };
+
+
+static bool isJcc(opcode op) { return op >= opcode::je && op <= opcode::jge; }
+static bool isSetcc(opcode op) { return op >= opcode::sete && op <= opcode::setge; }
+
+
+static opcode invert(opcode jcc) {
+    switch(jcc) {
+        case opcode::je:  return opcode::jne;
+        case opcode::jne: return opcode::je;
+        case opcode::jl:  return opcode::jge;
+        case opcode::jge: return opcode::jl;
+        case opcode::jle: return opcode::jg;
+        default:          return opcode::jle;
+    }
+}
+
+
+static bool uses(const operand& o,reg r) {
+    if(o.isReg()) return o.base == r;
+    if(o.isMem()) return o.base == r || o.index == r;
+    return false;
+}
+
+
+static bool callerSaved(reg r) {
+    switch(r) {
+        case reg::rbx: case reg::rsp: case reg::rbp:
+        case reg::r12: case reg::r13: case reg::r14: case reg::r15:
+            return false;
+        default:
+            return true;
+    }
+}
+
+
+// does 'in' read the old value of r (or the flags)?
+static bool reads(const inst& in,reg r) {
+    if(r == flags) return isJcc(in.op) || isSetcc(in.op);
+    switch(in.op) {
+        case opcode::mov:
+        case opcode::movsbq:
+        case opcode::movzbq:
+        case opcode::lea:
+            return uses(in.a,r) || (in.b.isMem() && uses(in.b,r));
+        case opcode::idiv:
+            return uses(in.a,r) || r == reg::rax || r == reg::rdx;
+        case opcode::cqo:
+            return r == reg::rax;
+        case opcode::pop:
+            return r == reg::rsp || (in.a.isMem() && uses(in.a,r));
+        case opcode::push:
+            return r == reg::rsp || uses(in.a,r);
+        case opcode::repmovsb:
+            return r == reg::rdi || r == reg::rsi || r == reg::rcx;
+        case opcode::repstosb:
+            return r == reg::rdi || r == reg::rcx || r == reg::rax;
+        default:
+            if(isSetcc(in.op)) return false;
+            return uses(in.a,r) || uses(in.b,r);
+    }
+}
+
+
+// does 'in' overwrite all of r (or the flags)?
+static bool writes(const inst& in,reg r) {
+    if(r == flags) {
+        switch(in.op) {
+            case opcode::add: case opcode::sub: case opcode::imul:
+            case opcode::idiv: case opcode::neg: case opcode::cmp:
+            case opcode::shl: case opcode::sar:
+                return true;
+            default:
+                return false;
+        }
+    }
+    switch(in.op) {
+        case opcode::mov:
+        case opcode::movsbq:
+        case opcode::movzbq:
+        case opcode::lea:
+        case opcode::add:
+        case opcode::sub:
+        case opcode::imul:
+        case opcode::shl:
+        case opcode::sar:
+            return in.b.isReg(r) && in.b.size >= 4;
+        case opcode::neg:
+        case opcode::pop:
+            return in.a.isReg(r);
+        // only the byte setcc writes is ever read back, by a movzbq
+        case opcode::sete: case opcode::setne: case opcode::setl:
+        case opcode::setle: case opcode::setg: case opcode::setge:
+            return in.a.isReg(r);
+        case opcode::idiv:
+            return r == reg::rax || r == reg::rdx;
+        case opcode::cqo:
+            return r == reg::rdx;
+        default:
+            return false;
+    }
+}
+
+
+static size_t findLabel(const std::vector<inst>& code,int32_t sym) {
+    for(size_t i = 0; i < code.size(); i++) {
+        if(code[i].op == opcode::label && code[i].a.sym == sym) return i;
+    }
+    return code.size();
+}
+
+
+/*
+ * may the value r holds before code[pos] still be read? walks forward along
+ * every path, giving up (and answering yes) after 'budget' jumps.
+ */
+static bool live(const std::vector<inst>& code,size_t pos,reg r,int& budget) {
+    while(pos < code.size()) {
+        const inst& in = code[pos];
+        if(in.op == opcode::jmp || isJcc(in.op)) {
+            if(reads(in,r) || --budget < 0) return true;
+            size_t target = findLabel(code,in.a.sym);
+            if(in.op == opcode::jmp) {
+                pos = target;
+                continue;
+            }
+            if(live(code,target,r,budget)) return true;
+        }else if(in.op == opcode::call) {
+            for(reg a : argregs) {
+                if(a == r) return true;
+            }
+            if(r == flags || callerSaved(r)) return false;
+        }else if(in.op == opcode::ret) {
+            return r == reg::rax;
+        }else {
+            if(reads(in,r)) return true;
+            if(writes(in,r)) return false;
+        }
+        pos++;
+    }
+    return true;
+}
+
+
+static bool live(const std::vector<inst>& code,size_t pos,reg r) {
+    int budget = 32;
+    return live(code,pos,r,budget);
+}
+
+
+static bool isReg64(const operand& o) {
+    return o.isReg() && o.size == 8;
+}
+
+
+static bool fitsImm32(const operand& o) {
+    return !o.isImm() || (o.val >= INT32_MIN && o.val <= INT32_MAX);
+}
+
+
+/*
+ * setcc %al; movzbq %al,%r; cmp $0,%r; je L  =>  jncc L
+ * the flags of the comparison before setcc are still intact, so the branch
+ * can test them directly. setcc and movzbq go too when nothing reads %r.
+ */
+static bool fusedBranch(std::vector<inst>& code,size_t i) {
+    if(i + 3 >= code.size() || !isSetcc(code[i].op)) return false;
+    const inst &mz = code[i + 1],&cmp = code[i + 2],&br = code[i + 3];
+    if(mz.op != opcode::movzbq || !mz.a.isReg(reg::rax) || !isReg64(mz.b)) return false;
+    if(cmp.op != opcode::cmp || !cmp.a.isImm() || cmp.a.val != 0 || cmp.b != mz.b) return false;
+    if(br.op != opcode::je && br.op != opcode::jne) return false;
+
+    opcode jcc = static_cast<opcode>(static_cast<int>(code[i].op) - static_cast<int>(opcode::sete) + static_cast<int>(opcode::je));
+    if(br.op == opcode::je) jcc = invert(jcc);
+    inst fused{jcc,br.a,{}};
+    reg r = mz.b.base;
+    if(!live(code,i + 3,r) && !live(code,i + 3,reg::rax)) {
+        code.erase(code.begin() + i + 1,code.begin() + i + 4);
+        code[i] = fused;
+    }else {
+        code.erase(code.begin() + i + 3);
+        code[i + 2] = fused;
+    }
+    return true;
+}
+
+
+// mov X,%r; mov %r,Y  =>  mov X,Y  when %r is dead afterwards
+static bool movChain(std::vector<inst>& code,size_t i) {
+    if(i + 1 >= code.size()) return false;
+    const inst &first = code[i],&second = code[i + 1];
+    if(first.op != opcode::mov || second.op != opcode::mov) return false;
+    if(!isReg64(first.b) || !isReg64(second.a) || second.a != first.b) return false;
+    reg r = first.b.base;
+    if(uses(second.b,r) && !second.b.isReg(r)) return false;
+    if(first.a.isMem() && second.b.isMem()) return false;
+    if(!fitsImm32(first.a) && !second.b.isReg()) return false;
+    if(second.b.isReg(r)) {
+        code.erase(code.begin() + i + 1);
+        return true;
+    }
+    if(live(code,i + 2,r)) return false;
+    inst merged{opcode::mov,first.a,second.b};
+    code.erase(code.begin() + i + 1);
+    code[i] = merged;
+    return true;
+}
+
+
+// mov %a,%b; mov %b,%a  =>  mov %a,%b
+static bool movBack(std::vector<inst>& code,size_t i) {
+    if(i + 1 >= code.size()) return false;
+    const inst &first = code[i],&second = code[i + 1];
+    if(first.op != opcode::mov || second.op != opcode::mov) return false;
+    if(!isReg64(first.a) || !isReg64(first.b)) return false;
+    if(second.a != first.b || second.b != first.a) return false;
+    code.erase(code.begin() + i + 1);
+    return true;
+}
+
+
+/*
+ * mov %a,%b; add %c,%b    =>  lea (%a,%c),%b
+ * mov %a,%b; add $n,%b    =>  lea n(%a),%b
+ * lea m,%b;  add $n,%b    =>  lea m+n,%b
+ * lea only computes the sum, so the flags of the add must be dead.
+ */
+static bool addToLea(std::vector<inst>& code,size_t i) {
+    if(i + 1 >= code.size()) return false;
+    const inst &first = code[i],&add = code[i + 1];
+    if(add.op != opcode::add || !isReg64(add.b) || add.b != first.b) return false;
+    reg b = add.b.base;
+    operand addr;
+    if(first.op == opcode::mov && isReg64(first.a) && first.a.base != reg::rsp) {
+        if(add.a.isImm() && fitsImm32(add.a)) {
+            addr = operand::mem(first.a.base,add.a.val);
+        }else if(isReg64(add.a) && add.a.base != b && add.a.base != reg::rsp) {
+            addr = operand::mem(first.a.base);
+            addr.index = add.a.base;
+        }else {
+            return false;
+        }
+    }else if(first.op == opcode::lea && add.a.isImm() && first.a.index == reg::none) {
+        addr = first.a;
+        addr.val += add.a.val;
+        if(addr.val < INT32_MIN || addr.val > INT32_MAX) return false;
+    }else {
+        return false;
+    }
+    if(live(code,i + 2,flags)) return false;
+    code.erase(code.begin() + i + 1);
+    code[i] = {opcode::lea,addr,operand::r(b)};
+    return true;
+}
+
+
+/*
+ * lea m,%r; op ...(%r)...  =>  op ...m...
+ * the address is folded into the one memory operand of the next
+ * instruction when %r is not needed afterwards.
+ */
+static bool foldLea(std::vector<inst>& code,size_t i) {
+    if(i + 1 >= code.size()) return false;
+    const inst &lea = code[i];
+    inst next = code[i + 1];
+    if(lea.op != opcode::lea || !isReg64(lea.b)) return false;
+    if(next.op == opcode::lea || next.op == opcode::label || next.op == opcode::call) return false;
+    reg r = lea.b.base;
+    operand *m = next.a.isMem() ? &next.a : next.b.isMem() ? &next.b : nullptr;
+    if(m == nullptr || m->base != r || m->index != reg::none) return false;
+    operand &other = m == &next.a ? next.b : next.a;
+    bool load = next.op == opcode::mov || next.op == opcode::movsbq || next.op == opcode::movzbq;
+    if(uses(other,r) && !(load && other.isReg(r) && m == &next.a)) return false;
+    int64_t disp = lea.a.val + m->val;
+    if(disp < INT32_MIN || disp > INT32_MAX) return false;
+    if(!writes(next,r) && live(code,i + 2,r)) return false;
+    operand folded = lea.a;
+    folded.val = disp;
+    *m = folded;
+    code.erase(code.begin() + i);
+    code[i] = next;
+    return true;
+}
+
+
+/*
+ * shl $k,%i; lea (%b,%i),%d  =>  lea (%b,%i,2^k),%d
+ * shl $k,%i; add %i,%d       =>  lea (%d,%i,2^k),%d
+ * the scaled index of the addressing mode does the shift, k <= 3.
+ */
+static bool scaleIndex(std::vector<inst>& code,size_t i) {
+    if(i + 1 >= code.size()) return false;
+    const inst &shl = code[i],&next = code[i + 1];
+    if(shl.op != opcode::shl || !shl.a.isImm() || shl.a.val < 1 || shl.a.val > 3 || !isReg64(shl.b)) return false;
+    reg idx = shl.b.base;
+    if(idx == reg::rsp) return false;
+    operand addr;
+    if(next.op == opcode::lea && next.a.index != reg::none && next.a.scale == 1 && next.a.base != reg::rip) {
+        addr = next.a;
+        if(addr.base == idx && addr.index != reg::rsp) std::swap(addr.base,addr.index);
+        if(addr.index != idx || addr.base == idx) return false;
+    }else if(next.op == opcode::add && next.a.isReg(idx) && isReg64(next.b) && !next.b.isReg(idx)) {
+        addr = operand::mem(next.b.base);
+        addr.index = idx;
+    }else {
+        return false;
+    }
+    addr.scale = 1 << shl.a.val;
+    reg dst = next.b.base;
+    if(live(code,i + 2,flags)) return false;
+    if(dst != idx && live(code,i + 2,idx)) return false;
+    code.erase(code.begin() + i + 1);
+    code[i] = {opcode::lea,addr,operand::r(dst)};
+    return true;
+}
+
+
+struct pattern {
+    const char *name;
+    bool (*rewrite)(std::vector<inst>& code,size_t i);
+};
+
+static const pattern patterns[] = {
+    { "fused-branch",fusedBranch },
+    { "mov-back",movBack },
+    { "mov-chain",movChain },
+    { "add-to-lea",addToLea },
+    { "fold-lea",foldLea },
+    { "scale-index",scaleIndex },
+};
+static constexpr size_t npatterns = sizeof(patterns) / sizeof(patterns[0]);
+
+
+void peephole::run(std::vector<inst>& code,stat& st) {
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(size_t i = 0; i < code.size(); i++) {
+            for(size_t p = 0; p < npatterns; p++) {
+                if(patterns[p].rewrite(code,i)) {
+                    st.counts[p]++;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+
+// a function starts at '.globl name' followed by '.text' and runs until the next .globl
+void peephole::run() {
+    std::vector<inst> &insts = emit.insts();
+    std::vector<inst> out;
+    out.reserve(insts.size());
+    size_t i = 0;
+    while(i < insts.size()) {
+        bool func = insts[i].op == opcode::globl && i + 1 < insts.size() && insts[i + 1].op == opcode::text;
+        size_t end = i + 1;
+        while(end < insts.size() && insts[end].op != opcode::globl) end++;
+        if(!func) {
+            out.insert(out.end(),insts.begin() + i,insts.begin() + end);
+            i = end;
+            continue;
+        }
+        std::vector<inst> code(insts.begin() + i,insts.begin() + end);
+        stat st{emit.name(insts[i].a.sym),std::vector<int>(npatterns)};
+        run(code,st);
+        out.insert(out.end(),code.begin(),code.end());
+        _stats.push_back(std::move(st));
+        i = end;
+    }
+    insts = std::move(out);
+}
+
+
+void peephole::report(std::ostream& os)const {
+    for(auto &st : _stats) {
+        int total = 0;
+        std::string detail;
+        for(size_t p = 0; p < npatterns; p++) {
+            if(st.counts[p] == 0) continue;
+            total += st.counts[p];
+            detail += std::format(" {}={}",patterns[p].name,st.counts[p]);
+        }
+        os << std::format("peephole: {}: {} rewrites{}\n",st.func,total,detail);
+    }
+}
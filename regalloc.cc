@@ -0,0 +1,143 @@
+#include "include/regalloc.h"
+#include <algorithm>
+#include <climits>
+
+static constexpr uint32_t callerSavedMask =
+    1u << static_cast<int>(reg::rax) | 1u << static_cast<int>(reg::rcx) |
+    1u << static_cast<int>(reg::rdx) | 1u << static_cast<int>(reg::rsi) |
+    1u << static_cast<int>(reg::rdi) | 1u << static_cast<int>(reg::r8)  |
+    1u << static_cast<int>(reg::r9)  | 1u << static_cast<int>(reg::r10) |
+    1u << static_cast<int>(reg::r11);
+
+
+bool regalloc::isCalleeSaved(reg r) {
+    return r == reg::rbx || r == reg::r12 || r == reg::r13 || r == reg::r14 || r == reg::r15;
+}
+
+
+regalloc::regalloc(const irFunc& f):
+    _frame_base(f.frame),
+    _regs(f.nregs,reg::none),
+    _slots(f.nregs,0) {
+    buildIntervals(f);
+    scan();
+    for(reg r : pool) {
+        if(isCalleeSaved(r) && std::find(_regs.begin(),_regs.end(),r) != _regs.end())
+            _saved.push_back(r);
+    }
+}
+
+
+void regalloc::buildIntervals(const irFunc& f) {
+    std::vector<int> start(f.nregs,INT_MAX),end(f.nregs,-1);
+    std::vector<reg> hint(f.nregs,reg::none);
+    auto extend = [&](int r,int pos) {
+        start[r] = std::min(start[r],pos);
+        end[r] = std::max(end[r],pos);
+    };
+    // registers clobbered by the instruction at a position
+    std::vector<std::pair<int,uint32_t>> clobbers;
+    // an incoming argument register stays busy until its parameter is read
+    std::vector<std::pair<int,uint32_t>> params;
+
+    irLiveness live(f);
+    int pos = 0;
+    for(size_t i = 0; i < f.blocks.size(); i++) {
+        auto &b = f.blocks[i];
+        int first = pos;
+        for(auto &in : b.insts) {
+            in.forUses([&](int r) { extend(r,pos); });
+            if(in.dst >= 0) extend(in.dst,pos);
+            if(in.op == irOp::call) clobbers.emplace_back(pos,callerSavedMask);
+            else if(in.op == irOp::div) clobbers.emplace_back(pos,bit(reg::rdx));
+            else if((in.op == irOp::blkcopy || in.op == irOp::blkzero) && in.args[0].v >= stringBytes)
+                clobbers.emplace_back(pos,bit(reg::rdi) | bit(reg::rsi) | bit(reg::rcx));
+            else if(in.op == irOp::param) {
+                params.emplace_back(pos,bit(argregs[in.a.v]));
+                hint[in.dst] = argregs[in.a.v];
+            }
+            pos++;
+        }
+        irLiveness::each(live.in[i],[&](int r) { extend(r,first); });
+        irLiveness::each(live.out[i],[&](int r) { extend(r,pos - 1); });
+    }
+
+    for(int r = 0; r < f.nregs; r++) {
+        if(end[r] < 0) continue;
+        interval it{r,start[r],end[r],bit(reg::rax) | bit(reg::r11),hint[r]};
+        for(auto [p,mask] : clobbers) {
+            if(it.start < p && p < it.end) it.forbid |= mask;
+        }
+        for(auto [p,mask] : params) {
+            if(it.start < p) it.forbid |= mask;
+        }
+        _intervals.push_back(it);
+    }
+    std::sort(_intervals.begin(),_intervals.end(),[](const interval& a,const interval& b) {
+        return a.start != b.start ? a.start < b.start : a.vreg < b.vreg;
+    });
+}
+
+
+void regalloc::spill(int vreg) {
+    _regs[vreg] = reg::none;
+    _slots[vreg] = -(_frame_base + 8 * ++_nspills);
+}
+
+
+void regalloc::scan() {
+    std::vector<const interval*> active;
+    uint32_t busy = 0;
+    for(auto &cur : _intervals) {
+        // an interval ending where another starts hands its register over:
+        // every instruction reads its operands before writing its result
+        for(auto it = active.begin(); it != active.end();) {
+            if((*it)->end <= cur.start) {
+                busy &= ~bit(_regs[(*it)->vreg]);
+                it = active.erase(it);
+            }else ++it;
+        }
+
+        reg chosen = reg::none;
+        if(cur.hint != reg::none && !(busy & bit(cur.hint)) && !(cur.forbid & bit(cur.hint)))
+            chosen = cur.hint;
+        for(reg r : pool) {
+            if(chosen != reg::none) break;
+            if(!(busy & bit(r)) && !(cur.forbid & bit(r))) {
+                chosen = r;
+                break;
+            }
+        }
+        if(chosen == reg::none) {
+            const interval *victim = nullptr;
+            for(auto *a : active) {
+                if(cur.forbid & bit(_regs[a->vreg])) continue;
+                if(victim == nullptr || a->end > victim->end) victim = a;
+            }
+            if(victim == nullptr || victim->end <= cur.end) {
+                spill(cur.vreg);
+                continue;
+            }
+            chosen = _regs[victim->vreg];
+            spill(victim->vreg);
+            active.erase(std::find(active.begin(),active.end(),victim));
+            busy &= ~bit(chosen);
+        }
+        _regs[cur.vreg] = chosen;
+        busy |= bit(chosen);
+        active.push_back(&cur);
+    }
+}
+
+
+operand regalloc::loc(int vreg)const {
+    if(_regs[vreg] != reg::none) return operand::r(_regs[vreg]);
+    return operand::mem(reg::rbp,_slots[vreg]);
+}
+
+
+// locals, then spill slots, then the save area of the callee-saved registers
+int regalloc::frameSize()const {
+    int size = _frame_base + 8 * (_nspills + _saved.size());
+    return (size + 15) / 16 * 16;
+}
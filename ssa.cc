@@ -0,0 +1,532 @@
+#include "include/ssa.h"
+
+#include <algorithm>
+#include <numeric>
+
+
+static bool isPhi(const irInst& in) {
+    return in.op == irOp::phi;
+}
+
+
+// reverse postorder of the blocks reachable from the entry
+void ssa::computeOrder() {
+    std::vector<bool> seen(func.blocks.size());
+    std::vector<std::pair<int,size_t>> stack{{0,0}};
+    _rpo.clear();
+    seen[0] = true;
+    while(!stack.empty()) {
+        int b = stack.back().first;
+        size_t i = stack.back().second++;
+        auto &succs = func.blocks[b].succs;
+        if(i == succs.size()) {
+            _rpo.push_back(b);
+            stack.pop_back();
+        }else if(!seen[succs[i]]) {
+            seen[succs[i]] = true;
+            stack.emplace_back(succs[i],0);
+        }
+    }
+    std::reverse(_rpo.begin(),_rpo.end());
+}
+
+
+// a branch on two constants, or to the same block both ways, becomes a jump
+bool ssa::foldBranches() {
+    bool changed = false;
+    for(size_t i = 0; i < func.blocks.size(); i++) {
+        auto &b = func.blocks[i];
+        auto &term = b.insts.back();
+        if(term.op != irOp::br) continue;
+        int taken;
+        if(term.a.isImm() && term.b.isImm()) taken = irCompare(term.cond,term.a.v,term.b.v) ? 0 : 1;
+        else if(b.succs[0] == b.succs[1]) taken = 0;
+        else continue;
+        // the edge not taken no longer feeds the phis at its end
+        int dropped = b.succs[1 - taken];
+        for(auto &in : func.blocks[dropped].insts) {
+            if(!isPhi(in)) break;
+            auto it = std::find(in.incoming.begin(),in.incoming.end(),static_cast<int>(i));
+            in.args.erase(in.args.begin() + (it - in.incoming.begin()));
+            in.incoming.erase(it);
+        }
+        b.succs = {b.succs[taken]};
+        term = irInst(irOp::jmp);
+        changed = true;
+    }
+    if(changed) func.computePreds();
+    return changed;
+}
+
+
+bool ssa::removeUnreachable() {
+    computeOrder();
+    if(_rpo.size() == func.blocks.size()) return false;
+    std::vector<int> index(func.blocks.size(),-1);
+    for(int b : _rpo) index[b] = 0;
+    int n = 0;
+    for(int &i : index) {
+        if(i == 0) i = n++;
+    }
+    func.renumber(index);
+    return true;
+}
+
+
+/*
+ * a block reached only by an unconditional jump joins the block jumping to
+ * it, and an empty block that only jumps on is bypassed.
+ */
+bool ssa::mergeBlocks() {
+    auto &blocks = func.blocks;
+    bool changed = false;
+    for(size_t i = 1; i < blocks.size(); i++) {
+        auto &b = blocks[i];
+        if(b.insts.size() != 1 || b.succs.size() != 1 || b.succs[0] == static_cast<int>(i)) continue;
+        int target = b.succs[0];
+        if(isPhi(blocks[target].insts.front())) continue;
+        for(int p : b.preds) {
+            for(int &s : blocks[p].succs) {
+                if(s == static_cast<int>(i)) s = target;
+            }
+        }
+        b.preds.clear();
+        changed = true;
+    }
+    if(changed) func.computePreds();
+
+    std::vector<int> index(blocks.size());
+    std::iota(index.begin(),index.end(),0);
+    bool merged = false;
+    for(size_t i = 0; i < blocks.size(); i++) {
+        auto &b = blocks[i];
+        if(index[i] < 0) continue;
+        while(b.succs.size() == 1) {
+            int s = b.succs[0];
+            auto &next = blocks[s];
+            if(s == 0 || s == static_cast<int>(i) || next.preds.size() != 1 || isPhi(next.insts.front())) break;
+            b.insts.pop_back();
+            for(auto &in : next.insts) b.insts.push_back(std::move(in));
+            b.succs = std::move(next.succs);
+            for(int t : b.succs) {
+                for(int &p : blocks[t].preds) {
+                    if(p == s) p = i;
+                }
+                for(auto &in : blocks[t].insts) {
+                    if(!isPhi(in)) break;
+                    for(int &from : in.incoming) {
+                        if(from == s) from = i;
+                    }
+                }
+            }
+            next = irBlock();
+            index[s] = -1;
+            merged = true;
+        }
+    }
+    if(merged) {
+        int n = 0;
+        for(int &i : index) {
+            if(i >= 0) i = n++;
+        }
+        func.renumber(index);
+    }
+    return changed || merged;
+}
+
+
+void ssa::simplifyCFG() {
+    bool changed = true;
+    while(changed) {
+        changed = foldBranches();
+        changed |= removeUnreachable();
+        changed |= mergeBlocks();
+    }
+}
+
+
+// replaces the result of every copy, and of every phi merging a single value, by that value
+bool ssa::propagateCopies() {
+    std::vector<irVal> value(func.nregs);
+    auto resolve = [&](irVal v) {
+        while(v.isReg() && !value[v.v].isNone()) v = value[v.v];
+        return v;
+    };
+    bool any = false,changed = true;
+    while(changed) {
+        changed = false;
+        for(auto &b : func.blocks) {
+            for(auto &in : b.insts) {
+                if(in.dst < 0 || !value[in.dst].isNone()) continue;
+                irVal v;
+                if(in.op == irOp::copy && (in.a.isReg() || in.a.isImm())) {
+                    v = resolve(in.a);
+                }else if(isPhi(in)) {
+                    bool same = true;
+                    for(auto &arg : in.args) {
+                        irVal x = resolve(arg);
+                        if(x == irVal::reg(in.dst)) continue;
+                        if(v.isNone()) v = x;
+                        else if(!(x == v)) same = false;
+                    }
+                    if(!same || v.isNone()) continue;
+                }else continue;
+                if(v == irVal::reg(in.dst)) continue;
+                value[in.dst] = v;
+                any = changed = true;
+            }
+        }
+    }
+    if(!any) return false;
+    for(auto &b : func.blocks) {
+        std::erase_if(b.insts,[&](const irInst& in) { return in.dst >= 0 && !value[in.dst].isNone(); });
+        for(auto &in : b.insts) {
+            in.mapUses([&](irVal& v) { v = resolve(v); });
+        }
+    }
+    return true;
+}
+
+
+// Cooper, Harvey and Kennedy's iteration over the reverse postorder
+void ssa::computeDominators() {
+    computeOrder();
+    size_t n = func.blocks.size();
+    std::vector<int> num(n);
+    for(size_t i = 0; i < _rpo.size(); i++) num[_rpo[i]] = i;
+    _idom.assign(n,-1);
+    _idom[0] = 0;
+    auto intersect = [&](int a,int b) {
+        while(a != b) {
+            while(num[a] > num[b]) a = _idom[a];
+            while(num[b] > num[a]) b = _idom[b];
+        }
+        return a;
+    };
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(size_t i = 1; i < _rpo.size(); i++) {
+            int b = _rpo[i],d = -1;
+            for(int p : func.blocks[b].preds) {
+                if(_idom[p] < 0) continue;
+                d = d < 0 ? p : intersect(p,d);
+            }
+            if(d != _idom[b]) {
+                _idom[b] = d;
+                changed = true;
+            }
+        }
+    }
+    children.assign(n,{});
+    for(int b : _rpo) {
+        if(b != 0) children[_idom[b]].push_back(b);
+    }
+    // number the tree in preorder; a dominates exactly the blocks numbered
+    // from it through the last block of its subtree
+    pre.assign(n,-1);
+    last.assign(n,-1);
+    int count = 0;
+    std::vector<std::pair<int,size_t>> stack{{0,0}};
+    pre[0] = count++;
+    while(!stack.empty()) {
+        auto &[b,k] = stack.back();
+        if(k < children[b].size()) {
+            int c = children[b][k++];
+            pre[c] = count++;
+            stack.emplace_back(c,0);
+        } else {
+            last[b] = count - 1;
+            stack.pop_back();
+        }
+    }
+}
+
+
+bool ssa::dominates(int a,int b)const {
+    return pre[b] >= 0 && pre[a] <= pre[b] && pre[b] <= last[a];
+}
+
+
+// a phi for r wherever two of its definitions meet and r is still live
+void ssa::insertPhis() {
+    auto &blocks = func.blocks;
+    size_t n = blocks.size();
+    std::vector<std::vector<int>> df(n);
+    for(size_t b = 0; b < n; b++) {
+        if(blocks[b].preds.size() < 2) continue;
+        for(int p : blocks[b].preds) {
+            for(int r = p; r != _idom[b]; r = _idom[r]) {
+                if(df[r].empty() || df[r].back() != static_cast<int>(b)) df[r].push_back(b);
+            }
+        }
+    }
+
+    std::vector<std::vector<int>> defblocks(func.nregs);
+    std::vector<int> ndefs(func.nregs);
+    for(size_t b = 0; b < n; b++) {
+        for(auto &in : blocks[b].insts) {
+            if(in.dst < 0) continue;
+            ndefs[in.dst]++;
+            if(defblocks[in.dst].empty() || defblocks[in.dst].back() != static_cast<int>(b))
+                defblocks[in.dst].push_back(b);
+        }
+    }
+
+    irLiveness live(func);
+    renamed.assign(func.nregs,false);
+    std::vector<std::vector<int>> phis(n);
+    std::vector<int> placed(n,-1),queued(n,-1);
+    for(int r = 0; r < func.nregs; r++) {
+        if(ndefs[r] > 1) renamed[r] = true;
+        std::vector<int> work = defblocks[r];
+        for(int d : work) queued[d] = r;
+        while(!work.empty()) {
+            int d = work.back();
+            work.pop_back();
+            for(int f : df[d]) {
+                if(placed[f] == r || !irLiveness::has(live.in[f],r)) continue;
+                placed[f] = r;
+                phis[f].push_back(r);
+                renamed[r] = true;
+                if(queued[f] != r) {
+                    queued[f] = r;
+                    work.push_back(f);
+                }
+            }
+        }
+    }
+
+    for(size_t b = 0; b < n; b++) {
+        std::vector<irInst> insts;
+        for(int r : phis[b]) {
+            irInst phi{irOp::phi,r};
+            for(int p : blocks[b].preds) {
+                phi.args.push_back(irVal::reg(r));
+                phi.incoming.push_back(p);
+            }
+            insts.push_back(std::move(phi));
+        }
+        blocks[b].insts.insert(blocks[b].insts.begin(),insts.begin(),insts.end());
+    }
+}
+
+
+/*
+ * gives each definition of a renamed vreg a fresh number. a use reached
+ * by no definition reads an uninitialized local, which becomes 0.
+ */
+void ssa::rename(int b,std::vector<std::vector<int>>& stacks) {
+    auto top = [&](int r) { return stacks[r].empty() ? irVal::imm(0) : irVal::reg(stacks[r].back()); };
+    auto isRenamed = [&](int r) { return r < static_cast<int>(renamed.size()) && renamed[r]; };
+    std::vector<int> pushed;
+    for(auto &in : func.blocks[b].insts) {
+        if(!isPhi(in)) {
+            in.mapUses([&](irVal& v) { if(v.isReg() && isRenamed(v.v)) v = top(v.v); });
+        }
+        if(in.dst >= 0 && isRenamed(in.dst)) {
+            int r = func.newReg();
+            stacks[in.dst].push_back(r);
+            pushed.push_back(in.dst);
+            in.dst = r;
+        }
+    }
+    // the phi arguments for this edge still name the original vreg
+    for(int s : func.blocks[b].succs) {
+        for(auto &in : func.blocks[s].insts) {
+            if(!isPhi(in)) break;
+            for(size_t k = 0; k < in.args.size(); k++) {
+                if(in.incoming[k] == b) in.args[k] = top(in.args[k].v);
+            }
+        }
+    }
+    for(int c : children[b]) rename(c,stacks);
+    for(int r : pushed) stacks[r].pop_back();
+}
+
+
+void ssa::construct() {
+    simplifyCFG();
+    computeDominators();
+    insertPhis();
+    std::vector<std::vector<int>> stacks(renamed.size());
+    rename(0,stacks);
+}
+
+
+/*
+ * mark and sweep: stores, block moves, calls, control flow and the vector
+ * registers' operations are needed, and so is whatever computes a value
+ * they read.
+ */
+void ssa::eliminateDeadCode() {
+    do {
+        simplifyCFG();
+    }while(propagateCopies());
+
+    auto critical = [](const irInst& in) {
+        return in.writesMemory() || in.isTerminator() || in.isVector();
+    };
+    std::vector<const irInst*> def(func.nregs);
+    std::vector<bool> needed(func.nregs);
+    std::vector<int> work;
+    auto need = [&](int r) {
+        if(!needed[r]) {
+            needed[r] = true;
+            work.push_back(r);
+        }
+    };
+    for(auto &b : func.blocks) {
+        for(auto &in : b.insts) {
+            if(in.dst >= 0) def[in.dst] = &in;
+            if(critical(in)) in.forUses(need);
+        }
+    }
+    while(!work.empty()) {
+        int r = work.back();
+        work.pop_back();
+        if(def[r]) def[r]->forUses(need);
+    }
+    for(auto &b : func.blocks) {
+        std::erase_if(b.insts,[&](const irInst& in) { return in.dst >= 0 && !needed[in.dst] && !critical(in); });
+    }
+    simplifyCFG();
+    func.shrinkFrame();
+}
+
+
+// every edge into a phi leaves a block with one successor, where the copies can go
+void ssa::splitCriticalEdges() {
+    auto &blocks = func.blocks;
+    size_t n = blocks.size();
+    std::vector<int> order;
+    for(size_t p = 0; p < n; p++) {
+        order.push_back(p);
+        if(blocks[p].succs.size() < 2) continue;
+        for(size_t k = 0; k < blocks[p].succs.size(); k++) {
+            int s = blocks[p].succs[k];
+            if(!isPhi(blocks[s].insts.front())) continue;
+            int e = blocks.size();
+            irBlock edge;
+            edge.insts.push_back({irOp::jmp});
+            edge.succs = {s};
+            blocks.push_back(std::move(edge));
+            blocks[p].succs[k] = e;
+            for(auto &in : blocks[s].insts) {
+                if(!isPhi(in)) break;
+                *std::find(in.incoming.begin(),in.incoming.end(),static_cast<int>(p)) = e;
+            }
+            order.push_back(e);
+        }
+    }
+    std::vector<int> index(blocks.size());
+    for(size_t i = 0; i < order.size(); i++) index[order[i]] = i;
+    func.renumber(index);
+}
+
+
+void ssa::destruct() {
+    auto &blocks = func.blocks;
+    splitCriticalEdges();
+
+    // copies in and out of every phi leave the phi's own resources independent
+    for(size_t s = 0; s < blocks.size(); s++) {
+        size_t nphi = 0;
+        while(nphi < blocks[s].insts.size() && isPhi(blocks[s].insts[nphi])) nphi++;
+        std::vector<irInst> results;
+        for(size_t i = 0; i < nphi; i++) {
+            for(size_t k = 0; k < blocks[s].insts[i].args.size(); k++) {
+                auto &phi = blocks[s].insts[i];
+                int t = func.newReg();
+                irInst copy{irOp::copy,t,phi.args[k]};
+                phi.args[k] = irVal::reg(t);
+                auto &insts = blocks[phi.incoming[k]].insts;
+                insts.insert(insts.end() - 1,std::move(copy));
+            }
+            auto &phi = blocks[s].insts[i];
+            int t = func.newReg();
+            results.push_back({irOp::copy,phi.dst,irVal::reg(t)});
+            phi.dst = t;
+        }
+        blocks[s].insts.insert(blocks[s].insts.begin() + nphi,results.begin(),results.end());
+    }
+
+    // where each vreg is defined, and whether it is live after a position
+    irLiveness live(func);
+    std::vector<std::pair<int,int>> where(func.nregs,{-1,-1});
+    for(size_t b = 0; b < blocks.size(); b++) {
+        for(size_t i = 0; i < blocks[b].insts.size(); i++) {
+            int d = blocks[b].insts[i].dst;
+            if(d >= 0) where[d] = {b,i};
+        }
+    }
+    auto liveAfter = [&](int x,int b,int i) {
+        auto &insts = blocks[b].insts;
+        if(where[x].first == b && where[x].second > i) return false;
+        for(size_t j = i + 1; j < insts.size(); j++) {
+            if(isPhi(insts[j])) continue;
+            bool used = false;
+            insts[j].forUses([&](int r) { used |= r == x; });
+            if(used) return true;
+        }
+        return irLiveness::has(live.out[b],x);
+    };
+    auto interfere = [&](int x,int y) {
+        if(where[x].first < 0 || where[y].first < 0) return false;
+        return liveAfter(x,where[y].first,where[y].second) || liveAfter(y,where[x].first,where[x].second);
+    };
+
+    std::vector<int> leader(func.nregs);
+    std::iota(leader.begin(),leader.end(),0);
+    std::vector<std::vector<int>> members(func.nregs);
+    for(int r = 0; r < func.nregs; r++) members[r] = {r};
+    auto find = [&](int r) {
+        while(leader[r] != r) r = leader[r] = leader[leader[r]];
+        return r;
+    };
+    auto unite = [&](int x,int y) {
+        x = find(x);
+        y = find(y);
+        if(x == y) return;
+        if(members[x].size() < members[y].size()) std::swap(x,y);
+        leader[y] = x;
+        members[x].insert(members[x].end(),members[y].begin(),members[y].end());
+        members[y].clear();
+    };
+    for(auto &b : blocks) {
+        for(auto &in : b.insts) {
+            if(!isPhi(in)) break;
+            for(auto &arg : in.args) unite(in.dst,arg.v);
+        }
+    }
+    for(auto &b : blocks) {
+        for(auto &in : b.insts) {
+            if(in.op != irOp::copy || !in.a.isReg()) continue;
+            int x = find(in.dst),y = find(in.a.v);
+            if(x == y) continue;
+            bool clash = false;
+            for(int u : members[x]) {
+                for(int v : members[y]) {
+                    if(interfere(u,v)) {
+                        clash = true;
+                        break;
+                    }
+                }
+                if(clash) break;
+            }
+            if(!clash) unite(x,y);
+        }
+    }
+
+    for(auto &b : blocks) {
+        for(auto &in : b.insts) {
+            if(in.dst >= 0) in.dst = find(in.dst);
+            in.mapUses([&](irVal& v) { if(v.isReg()) v.v = find(v.v); });
+        }
+        std::erase_if(b.insts,[](const irInst& in) {
+            return isPhi(in) || (in.op == irOp::copy && in.a == irVal::reg(in.dst));
+        });
+    }
+    // split edges that needed no copies are empty again
+    mergeBlocks();
+}
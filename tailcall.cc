@@ -0,0 +1,56 @@
+#include "include/tailcall.h"
+
+#include <algorithm>
+
+
+bool tailcall::run(irFunc& f) {
+    // a pointer into the frame may be passed on, so the frame cannot be reused
+    if(f.addressesFrame()) return false;
+    int self = mod.intern(f.name);
+    auto isSelf = [&](const irBlock& b) {
+        size_t i = b.insts.size() - 2;
+        return b.isTailCall(i) && b.insts[i].sym == self &&
+               b.insts[i].args.size() == static_cast<size_t>(f.nparams);
+    };
+    if(std::none_of(f.blocks.begin(),f.blocks.end(),isSelf)) return false;
+
+    // the entry keeps reading the parameters and the rest of it becomes the loop
+    auto &entry = f.blocks[0];
+    std::vector<int> params(f.nparams,-1);
+    size_t n = 0;
+    while(n < entry.insts.size() && entry.insts[n].op == irOp::param) {
+        params[entry.insts[n].a.v] = entry.insts[n].dst;
+        n++;
+    }
+    irBlock body;
+    body.insts.assign(entry.insts.begin() + n,entry.insts.end());
+    body.succs = std::move(entry.succs);
+    entry.insts.erase(entry.insts.begin() + n,entry.insts.end());
+    entry.insts.push_back({irOp::jmp});
+    entry.succs = {1};
+    f.blocks.insert(f.blocks.begin() + 1,std::move(body));
+    for(size_t b = 1; b < f.blocks.size(); b++) {
+        for(int &s : f.blocks[b].succs) {
+            if(s >= 1) s++;
+        }
+    }
+
+    for(auto &b : f.blocks) {
+        if(&b == &f.blocks[0] || !isSelf(b)) continue;
+        irInst call = std::move(b.insts[b.insts.size() - 2]);
+        b.insts.erase(b.insts.end() - 2,b.insts.end());
+        // the arguments may read parameters, so all are taken before any is set
+        std::vector<int> temps;
+        for(auto &arg : call.args) {
+            temps.push_back(f.newReg());
+            b.insts.push_back({irOp::copy,temps.back(),arg});
+        }
+        for(int k = 0; k < f.nparams; k++) {
+            if(params[k] >= 0) b.insts.push_back({irOp::copy,params[k],irVal::reg(temps[k])});
+        }
+        b.insts.push_back({irOp::jmp});
+        b.succs = {1};
+    }
+    f.computePreds();
+    return true;
+}
@@ -1,13 +1,13 @@
 # this file is basically from chibicc(https://github.com/rui314/chibicc)
 #!/bin/bash
 afterexit() {
-    rm -f tmp tmp.s
+    rm -f tmp tmp.s tmp.o
     exit
 }
 assert() {
     expected="$1"
     input="$2"
-    ./build/wizardc "$input" 2 > tmp.s || afterexit
+    ./build/wizardc "$input" -o tmp.s || afterexit
     gcc -static -o tmp tmp.s
     ./tmp
     actual="$?"
@@ -19,6 +19,24 @@ assert() {
         echo "$input => $expected expected ,but got $actual"  
         afterexit
     fi
+
+    # the same program through the built-in assembler and ELF writer, framed by %rsp
+    ./build/wizardc "$input" -c -o tmp.o -fomit-frame-pointer || afterexit
+    gcc -static -o tmp tmp.o
+    ./tmp
+    actual="$?"
+    if [ "$actual" != "$expected" ]; then
+        echo "$input => $expected expected ,but got $actual (-c)"
+        afterexit
+    fi
+
+    # and once more in-process
+    ./build/wizardc "$input" --run
+    actual="$?"
+    if [ "$actual" != "$expected" ]; then
+        echo "$input => $expected expected ,but got $actual (--run)"
+        afterexit
+    fi
 }
 
 assert 0 "int main(){ return 0;}"
@@ -88,7 +106,7 @@ assert 2 "int main() { char a = 1,b = 1;return a + b;}"
 assert 2 "int main() { char a[3] = {1,2,3};return a[1];}"
 assert 98 "int main() { char *s = \"abc\";return s[1];}"
 assert 98 "int main() { char *s = \"abc\",*p = s;return p[1];}"
-assert 98 "int test(char *s) { s[0] = 98;} int main() { char *s = \"bbb\"; test(s);return s[0];}"
+assert 98 "int test(char *s) { s[0] = 98;} int main() { char s[4] = {97, 97, 97}; test(s);return s[0];}"
 assert 3 "int main() { int i = 0; while(i < 3) i = i+1;return i;}"
 assert 10 "int main() { int arr[3] = {2,3,5},i = 0,total = 0;while(i < 3){ total = total + arr[i]; i = i + 1;} return total; }"
 assert 10 "int main() { int arr[3] = {2,3,5},i = 0,total = 0,*p = arr;while(i < 3){ total = total + *p; p = p + 1;i=i+1;} return total; }"
@@ -96,5 +114,56 @@ assert 10 "int main() { int sum = 0;for(int i = 0; i < 10; i = i + 1) sum = sum
 assert 10 "int main() { int sum = 0,arr[3] = {2,3,5};for(int i = 0; i < 3; i = i + 1) sum = sum + arr[i];return sum;}"
 assert 10 "int main() { int sum = 0,i = 0,arr[3] = {2,3,5};for(; i < 3; i = i + 1) sum = sum + arr[i];return sum;}"
 assert 10 "int main() { int sum = 0,i = 0,arr[3] = {2,3,5};for(; i < 3;){ sum = sum + arr[i]; i = i + 1;}return sum;}"
+assert 36 "int main() { return ((((((1+2)+3)+4)+5)+6)+7)+8; }"
+assert 21 "int add(int a,int b,int c,int d,int e,int f) { return a+b+c+d+e+f;} int main() { return add(1,2,3,4,5,add(1,1,1,1,1,1)); }"
+assert 97 "int test(char *s) { s[1] = 97;} int main() { char s[4] = {98, 98, 98}; test(s);return s[1];}"
+assert 31 "int f(int a,int b,int c,int d,int e){return a*1+b*2+c*3+d*4+e*5;} int main(){return f(1,f(1,1,1,1,0),2,f(0,0,0,0,1)-4,0);}"
+assert 8 "int f(int a,int b){ a = b - a; return a;} int main(){ int x = 3; char c[2] = {4,5}; return f(c[0] - x,c[1]) + c[0] - 2 + x - 1;}"
+assert 19 "int main() { return (0x1*0x10 + 0x3); }"
+assert 1 "int main() { return 1000000*1000000/1000000/1000000 + -(2-5)*-1 + 3; }"
+assert 5 "int g; int f() { g = 5; return 1; } int main() { int x = 4; f()*0; return g + x*0 + (x-0)/1*1 - 4; }"
+assert 5 "int g[3]; int main() { int i; for(i = 0; i < 3; i = i + 1) { if(i >= 1) g[i] = i; if(i <= 1) g[i] = g[i] + 1; } return g[0] + g[1] + g[2] + (g[2] != 2)*10; }"
+assert 3 "int main() { int a = 2,b = 5,n = 0; while(a < b) { if(a > 3 == 0) n = n + 1; a = a + 1; } return n + (a == b) + (a < b); }"
+assert 16 "int g; char s[3]; int f(char *p) { return p[1]; } int main() { char *t = \"a\\tb\\n\"; g = f(t); s[1] = 7; return g + s[1]; }"
+assert 12 "int strlen(char *s); int putchar(int c); int main() { putchar(79); putchar(10); return strlen(\"hello world!\"); }"
+assert 7 "int main() { int n = 0,i; for(i = 10; 4 < i; i = i - 1) { if(3 >= n) n = n + 2; else if(i != 7) n = n + 1; } while(n == 9 - 1) n = n + 1; return n; }"
+assert 23 "int g[8]; int main() { int a[4],i; char *p,*q; char b[9]; p = b; q = p + 5; for(i = 0; i < 4; i = i + 1) { a[i] = i*4; g[i+1] = a[i]; } int *x = &g[1],*y = &g[4]; return (y - x) + (q - p) + g[3] + (p + 3 - p) + (q - 1 - p); }"
+assert 9 "int sq(int x){ return x*x; } int main(){ return sq(3); }"
+assert 12 "int f(int a,int b){ a=a+b; b=a*2; return b; } int main(){ return f(2,4); }"
+assert 7 "int set(int *p){ *p=7; return 0; } int f(int a){ set(&a); return a; } int main(){ return f(1); }"
+assert 21 "int g(int a,int b,int c,int d,int e,int f){ int t[4]; t[0]=a+b; t[1]=c+d; t[2]=e+f; return t[0]+t[1]+t[2]; } int main(){ return g(1,2,3,4,5,6); }"
+assert 21 "int main(){ int a; int b; int i; int t; a=1; b=2; for(i=0;i<3;i=i+1){ t=a; a=b; b=t; } return a*10+b; }"
+assert 54 "int main(){ int x; int y; x=0; while(x<5){ y=x; x=x+1; } return y+x*10; }"
+assert 7 "int f(int x){ return x; x=3; return 9; } int main(){ return f(7); }"
+assert 2 "int main(){ int x; if(0) x=1; else x=2; while(0) x=9; return x; }"
+assert 40 "int a[100]; int g; int main(){ int i; int s; int k; s=0; k=3; g=2; for(i=0;i<100;i=i+1){ a[i]=i*k+g; } for(i=0;i<100;i=i+1){ s=s+a[i]*(k+1); } return s-s/256*256; }"
+assert 36 "int g; int main(){ int i; int j; int s; s=0; g=2; for(i=0;i<3;i=i+1){ for(j=0;j<3;j=j+1){ s=s+g*2; } } return s; }"
+assert 19 "int sum3(int a){ int t[3]; t[0]=a; t[1]=a*2; t[2]=a*3; return t[0]+t[1]+t[2]; } int main(){ int x[2]; x[0]=1; x[1]=sum3(2); return x[0]+x[1]+sum3(1); }"
+assert 11 "int odd(int n); int even(int n){ if(n==0) return 1; return odd(n-1); } int odd(int n){ if(n==0) return 0; return even(n-1); } int main(){ return even(10)*10+odd(7); }"
+assert 5 "int set(int *p,int v){ *p=v; return v; } int f(int a){ int b; set(&b,a+1); return b; } int main(){ return f(4); }"
+assert 3 "int odd(int n); int even(int n){ if(n==0) return 1; return odd(n-1); } int odd(int n){ if(n==0) return 0; return even(n-1); } int sum(int n,int acc){ if(n==0) return acc; return sum(n-1,acc+n); } int main(){ return even(10000001)*10+sum(10000000,0)-50000005000000+3; }"
+assert 6 "int gcd(int a,int b){ if(b==0) return a; return gcd(b,a-a/b*b); } int main(){ return gcd(48,18); }"
+assert 45 "int a[10]; int main(){ int i; int s; for(i=0;i<10;i=i+1) a[i]=i; s=0; for(i=9;i>=0;i=i-1) s=s+a[i]; return s; }"
+assert 49 "int main(){ int a[6]; int b[6]; char c[6]; int i; int s; for(i=0;i<6;i=i+1){ a[i]=i; c[i]=i*2; } for(i=0;i<5;i=i+1) b[i]=a[i+1]+c[i]; s=0; for(i=1;i<=5;i=i+2) s=s+b[i-1]*2; return s+i; }"
+assert 217 "int a[100]; int b[100]; int c[100]; int main(){ int i; int s; for(i=0;i<100;i=i+1){ a[i]=i; b[i]=i*2; } for(i=0;i<99;i=i+1) c[i]=a[i]+b[i]; s=0; for(i=0;i<99;i=i+1) s=s+c[i]; return s-s/256*256; }"
+assert 214 "char p[64]; char q[64]; int r[40]; int t[40]; int f(int *x,int *y,int n,int k){ int i; int s; s=0; for(i=0;i<n;i=i+1){ x[i]=y[i]-k; s=s-x[i]; } return s; } int main(){ int i; for(i=0;i<60;i=i+1) q[i]=i; for(i=0;i<60;i=i+1) p[i]=q[i]+q[i+1]-3; for(i=0;i<40;i=i+1) t[i]=i; return f(r,t,37,2)+p[20]; }"
+assert 185 "int a[50]; int f(int *x,int *y,int n){ int i; for(i=0;i<n;i=i+1) x[i]=y[i]+1; return 0; } int main(){ int i; int s; for(i=0;i<50;i=i+1) a[i]=i; for(i=0;i<40;i=i+1) a[i+1]=a[i]+a[i+1]; f(a+1,a,30); f(a,a,10); f(a+20,a,20); f(a,a+3,20); s=0; for(i=0;i<50;i=i+1) s=s+a[i]*(i+1); return s-s/256*256; }"
+assert 37 "int a[10]; int b[10]; int f(int i){ a[i] = a[i] + b[i] * b[i]; if(a[i] > 3) return a[i] + b[i]; return a[i]; } int main(){ a[2]=1; b[2]=3; return f(2) + f(2) + (2 < a[2]) + (a[2] > 2); }"
+assert 14 "int g; int bump(){ g = g + 5; return 0; } int main(){ int *p; int x; int y; p = &g; g = 1; x = *p + *p; bump(); y = *p + *p; *p = 0; return x + y - *p; }"
+assert 123 "int f(int k){ int t[40] = {3, -1, 4, 1, 5, 9, 2, 6, k, 5}; char c[20] = {1, 2, 3}; int s; int i; s = 0; for(i = 0; i < 40; i = i + 1) s = s + t[i]; for(i = 0; i < 20; i = i + 1) s = s + c[i]; return s; } int main(){ int i; int s; s = 0; for(i = 0; i < 3; i = i + 1) s = s + f(i); return s; }"
+assert 25 "int g(int k){ int t[100] = {1, 2, k}; int u[34] = {9,8,7,6,5,4,3,2,1,0,9,8,7,6,5,4,3,2,1,0,9,8,7,6,5,4,3,2,1,0,9,8,7,6}; char c[5] = {7}; int s; int i; s = 0; for(i = 0; i < 100; i = i + 1) s = s + t[i]; for(i = 0; i < 34; i = i + 1) s = s + u[i]; for(i = 0; i < 5; i = i + 1) s = s + c[i]; t[50] = 3; return s; } int main(){ int i; int s; s = 0; for(i = 0; i < 3; i = i + 1) { int a[12] = {i, 1, 1, 1, 1}; a[6] = a[0] + 1; s = s + g(i) + a[6] + a[7] + a[1]; } return s; }"
+assert 98 "int sq[8] = {0, 1, 4, 9, 16, 25, 36, 49}; int n = 3 * 4 - 2; char tag[6] = {104, 105, -1}; int g; int *gp = &g; int *mid = sq + 4; int *third = &sq[3]; char *msg = \"hey\"; int cnt[4] = {5, 6}; int main(){ int i; int s; s = 0; for(i = 0; i < 8; i = i + 1) s = s + sq[i]; *gp = 7; cnt[3] = cnt[0] + 1; return s + n + tag[0] + tag[2] + tag[5] + g + *mid + *third + msg[1] + cnt[1] + cnt[3] + cnt[2] - 300; }"
+assert 182 "int tbl[16] = {3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9, 3}; char hex[16] = {48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 97, 98, 99, 100, 101, 102}; int scale = 3; int out[16]; int main(){ int i; int s; s = 0; for(i = 0; i < 16; i = i + 1) out[i] = tbl[i] + hex[i]; for(i = 0; i < 16; i = i + 1) s = s + out[i] * scale; return s - 2400; }"
+assert 17 "char *names[2] = {\"world\", \"hello world\"}; int main(){ char *a; char *b; a = \"hello world\"; b = \"world\"; return (b - a) + (names[1] - a) + (names[0] - b) + b[4] - 100 + 11; }"
+assert 10 "int main(){ int whil; int fo; int returnx; int iff; int chat; whil = 1; fo = 2; returnx = 3; iff = 4; chat = 0; return whil + fo + returnx + iff + chat; }"
+assert 10 "int f(int a,int b){return a-b;} int main(){return f(1000000*1000000+10,1000000*1000000);}"
+assert 1 "int g(int a,int b,int c){return a-b+c;} int main(){return g(3000000000,3000000000+2,3);}"
+assert 1 "int main(){ int a; int b; a = 1000000*1000000; b = 1000000*1000000+1; return b - a; }"
+assert 1 "int main(){ int a; int b; a = 1000000*1000000; b = 1000000*1000000+1; return a < b; }"
+assert 1 "int main(){ int a; int b; a = 1000000*1000000; b = 1000000*1000000+1; if(a < b) return 1; return 0; }"
+assert 4 "int f(int *a,int n){ int i; int s; s = 0; for(i = 0; i < n; i = i + 1) { if(i >= 4) return s; s = s + 1; a[i] = 1; } return s; } int main(){ int a[8]; return f(a, 1024*1024*1024*1024*1024*1024*4); }"
+assert 3 "int f(int x){int i;int s;s=0;for(i=0;i<1000;i=i+1) s=s+(x+i);return s;} int main(){int a;int x;a=1000000000;x=a*a*9+223372036*a+854775707;return f(x)-f(x-1000000)+3;}"
+assert 5 "int a[8]; int f(int n){int i;for(i=0;i<n;i=i+1) a[i]=a[i]+1;return a[0];} int main(){int m;m=1000000000;return f(0-m*m*9-223372036*m-854775807)+5;}"
+assert 5 "int a[8]; int f(int n){int i;for(i=0;i<n;i=i+1) a[i]=a[i]+1;return a[0];} int main(){int m;m=1000000000;return f(0-m*m*9-223372036*m-854775807-1)+5;}"
 echo "OK"
 afterexit
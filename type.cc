@@ -1,28 +1,28 @@
 #include "include/type.h"
 
-bool Type::isPointer(std::shared_ptr<Type> type) {
+bool Type::isPointer(Type *type) {
     return type->getKind() == Kind::T_ptr;
 }
 
-bool Type::isInteger(std::shared_ptr<Type> type) {
+bool Type::isInteger(Type *type) {
     return type->getKind() == Kind::T_int || type->getKind() == Kind::T_char;
 }
 
-bool Type::isArray(std::shared_ptr<Type> type) {
+bool Type::isArray(Type *type) {
     return type->getKind() == Kind::T_array;
 }
 
-bool Type::arePtrCompatible(const std::shared_ptr<Type>& lhs,const std::shared_ptr<Type>& rhs) {
+bool Type::arePtrCompatible(Type *lhs,Type *rhs) {
     if(!isPointer(lhs) || !isPointer(rhs)) return false;
-    auto lbase = static_cast<pointerType*>(lhs.get())->getBaseType();
-    auto rbase = static_cast<pointerType*>(rhs.get())->getBaseType();
-    return lbase->getKind() == rhs->getKind();
+    auto lbase = static_cast<pointerType*>(lhs)->getBaseType();
+    auto rbase = static_cast<pointerType*>(rhs)->getBaseType();
+    return lbase->getKind() == rbase->getKind();
 }
 
-std::shared_ptr<Type> typeChecker::checkBinaryOp(
+Type *typeChecker::checkBinaryOp(
     tokenType op,
-    const std::shared_ptr<Type>& lhs,
-    const std::shared_ptr<Type>& rhs){
+    Type *lhs,
+    Type *rhs){
     
     if(op == tokenType::T_assign) return checkEqual(lhs,rhs);
     auto l = decayArrayToPointer(lhs);
@@ -35,10 +35,10 @@ std::shared_ptr<Type> typeChecker::checkBinaryOp(
 }
 
 
-std::shared_ptr<Type> pointerTypeCheck::checkBinaryOp(
+Type *pointerTypeCheck::checkBinaryOp(
         tokenType op,
-        const std::shared_ptr<Type>& lhs,
-        const std::shared_ptr<Type>& rhs){
+        Type *lhs,
+        Type *rhs){
 
         switch(op) {
             case tokenType::T_plus:
@@ -56,9 +56,9 @@ std::shared_ptr<Type> pointerTypeCheck::checkBinaryOp(
 }
 
 
-std::shared_ptr<Type> pointerTypeCheck::checkAddtion(
-    const std::shared_ptr<Type>& lhs,
-    const std::shared_ptr<Type>& rhs) {
+Type *pointerTypeCheck::checkAddtion(
+    Type *lhs,
+    Type *rhs) {
 
     bool leftPtr = Type::isPointer(lhs);
     bool leftInteger = Type::isInteger(lhs);
@@ -73,9 +73,9 @@ std::shared_ptr<Type> pointerTypeCheck::checkAddtion(
 }
 
 
-std::shared_ptr<Type> pointerTypeCheck::checkSubtraction(
-    const std::shared_ptr<Type>& lhs,
-    const std::shared_ptr<Type>& rhs) {
+Type *pointerTypeCheck::checkSubtraction(
+    Type *lhs,
+    Type *rhs) {
 
     bool leftPtr = Type::isPointer(lhs);
     bool rightPtr = Type::isPointer(rhs);
@@ -92,15 +92,15 @@ std::shared_ptr<Type> pointerTypeCheck::checkSubtraction(
     throw std::format("invalid operand of '{}' and '{}' to '-'",lhs->typestr(),rhs->typestr());
 }
 
-std::shared_ptr<Type> typeChecker::decayArrayToPointer(const std::shared_ptr<Type>& type) {
+Type *typeChecker::decayArrayToPointer(Type *type) {
     if(Type::isArray(type)) {
-        return typeFactor::getPointerType(static_cast<arrayType*>(type.get())->elemTy());
+        return typeFactor::getPointerType(static_cast<arrayType*>(type)->elemTy());
     }
     return type;
 }
 
 
-std::shared_ptr<Type> typeChecker::checkEqual(const std::shared_ptr<Type>& lhs,const std::shared_ptr<Type>& rhs) {
+Type *typeChecker::checkEqual(Type *lhs,Type *rhs) {
     auto decay_r = decayArrayToPointer(rhs);
 
     if(!isPointer(lhs) || !isPointer(decay_r)){
@@ -109,10 +109,10 @@ std::shared_ptr<Type> typeChecker::checkEqual(const std::shared_ptr<Type>& lhs,c
         }
         throw std::format("'=' has different types at both side:'{}' at left and '{}' at right",lhs->typestr(),rhs->typestr());
     }else {
-        std::shared_ptr<Type> l = lhs,r = decay_r;
+        Type *l = lhs,*r = decay_r;
         while(isPointer(l) && isPointer(r)){
-            l = static_cast<pointerType*>(l.get())->getBaseType();
-            r = static_cast<pointerType*>(r.get())->getBaseType();
+            l = static_cast<pointerType*>(l)->getBaseType();
+            r = static_cast<pointerType*>(r)->getBaseType();
         }
         if(l->getKind() == r->getKind()){
             return lhs;
@@ -0,0 +1,313 @@
+#include "include/vectorizer.h"
+
+#include <algorithm>
+
+
+/*
+ * may x and y (x first in the loop, one of them a store) run a vector at a
+ * time? when both address one array that depends on how far apart they
+ * are; when they might address one array, on a check recorded in 'checks'.
+ */
+bool vectorizer::independent(const access& x,const access& y,std::vector<pair>& checks)const {
+    auto object = [&](const irVal& base) {
+        const irInst *d = base.isReg() ? defs[base.v] : nullptr;
+        return d && d->op == irOp::addr ? d->a : irVal{};
+    };
+    if(!(x.f.base == y.f.base)) {
+        irVal ox = object(x.f.base),oy = object(y.f.base);
+        if(ox.isNone() || oy.isNone()) {
+            checks.push_back({&x,&y});
+            return true;
+        }
+        if(!(ox == oy)) return true;
+    }
+    // a vector later in the loop only sees what one earlier stored
+    const access &st = y.store ? y : x,&other = y.store ? x : y;
+    int64_t d = st.f.k - other.f.k;
+    if(d == 0 || d >= width || d <= -width) return true;
+    // a load ahead of where it is stored reads what the scalar loop would
+    return !other.store && d < 0 && &other == &x;
+}
+
+
+bool vectorizer::vectorize(const irLoop& l) {
+    auto &blocks = func.blocks;
+    if(l.size != 2 || l.latches.size() != 1 || l.latches[0] == l.header) return false;
+    int h = l.header,b = l.latches[0],pre = l.preheader;
+    const auto &head = blocks[h].insts,&body = blocks[b].insts;
+    const irInst &test = head.back();
+    if(test.op != irOp::br || blocks[h].succs[0] != b) return false;
+
+    std::vector<int> uses(func.nregs);
+    for(auto *insts : { &head,&body }) {
+        for(auto &in : *insts) in.forUses([&](int r) { uses[r]++; });
+    }
+
+    // the counter, and sums whose phi feeds only their update and back
+    struct sum {
+        int phi;
+        int update;
+        irVal init;
+        int acc;
+    };
+    std::vector<sum> sums;
+    int iv = -1;
+    irVal init;
+    size_t nphis = 0;
+    for(auto &in : head) {
+        if(in.op != irOp::phi) break;
+        nphis++;
+        if(in.args.size() != 2) return false;
+        int kp = in.incoming[0] == pre ? 0 : 1;
+        irVal back = in.args[1 - kp];
+        if(!back.isReg() || defblock[back.v] != b) return false;
+        const irInst *d = defs[back.v];
+        irVal self = irVal::reg(in.dst),one = irVal::imm(1);
+        if(iv < 0 && d->op == irOp::add && ((d->a == self && d->b == one) || (d->a == one && d->b == self))) {
+            iv = in.dst;
+            init = in.args[kp];
+            continue;
+        }
+        bool update = (d->op == irOp::add && (d->a == self || d->b == self)) || (d->op == irOp::sub && d->a == self);
+        if(!update || uses[in.dst] != 1 || uses[back.v] != 1) return false;
+        sums.push_back({in.dst,static_cast<int>(back.v),in.args[kp],-1});
+    }
+    if(iv < 0 || nphis + 1 != head.size() || std::find(done.begin(),done.end(),iv) != done.end()) return false;
+    irOp cc = test.cond;
+    irVal bound;
+    if(test.a == irVal::reg(iv) && invariant(test.b,l)) {
+        bound = test.b;
+    }else if(test.b == irVal::reg(iv) && invariant(test.a,l)) {
+        bound = test.a;
+        cc = irSwapped(cc);
+    }else {
+        return false;
+    }
+    if(cc != irOp::lt && cc != irOp::le) return false;
+
+    // vregs made for an attempt that fails are given back
+    int saved = func.nregs;
+    auto fail = [&] {
+        func.nregs = saved;
+        return false;
+    };
+    int vi = func.newReg();
+    std::vector<affine> forms(saved);
+    std::vector<int> vreg(saved,-1);        // vector register holding each vreg's lanes
+    std::vector<access> accesses;
+    std::vector<std::pair<affine,irVal>> addrs;
+    std::vector<irInst> setup,kernel;
+    int size = 0,nvec = 0;
+    forms[iv] = {iv,1,{},0};
+
+    auto formOf = [&](const irVal& v) { return v.isReg() && v.v < saved ? forms[v.v] : affine{}; };
+    auto isVec = [&](const irVal& v) { return v.isReg() && v.v < saved && vreg[v.v] >= 0; };
+    auto vop = [&](std::vector<irInst>& insts,irOp op,int r,const irVal& v) {
+        irInst in{op,-1,irVal::vec(r),v};
+        in.size = size;
+        insts.push_back(std::move(in));
+    };
+    // an operand's lanes: a vector value, or an invariant broadcast ahead of the loop
+    auto lanesOf = [&](const irVal& v) {
+        if(isVec(v)) return vreg[v.v];
+        if(!invariant(v,l) || size == 0) return -1;
+        vop(setup,irOp::vsplat,nvec,v);
+        return nvec++;
+    };
+    // the vector loop's own address arithmetic, on its own counter
+    auto address = [&](const affine& f) {
+        auto it = std::find_if(addrs.begin(),addrs.end(),[&](auto& a) { return a.first == f; });
+        if(it != addrs.end()) return it->second;
+        irVal v = emit(kernel,irOp::mul,irVal::reg(vi),irVal::imm(f.m));
+        v = emit(kernel,irOp::add,v,irVal::imm(f.k));
+        v = emit(kernel,irOp::add,f.base,v);
+        addrs.push_back({f,v});
+        return v;
+    };
+    for(size_t i = 0; i + 1 < body.size(); i++) {
+        const irInst &in = body[i];
+        auto s = std::find_if(sums.begin(),sums.end(),[&](const sum& s) { return s.update == in.dst; });
+        if(s != sums.end()) {
+            if(size == 0) size = 8;
+            int r = lanesOf(in.a == irVal::reg(s->phi) ? in.b : in.a);
+            if(size != 8 || r < 0) return fail();
+            s->acc = nvec++;
+            vop(setup,irOp::vsplat,s->acc,irVal::imm(0));
+            vop(kernel,in.op == irOp::add ? irOp::vadd : irOp::vsub,s->acc,irVal::vec(r));
+            continue;
+        }
+        switch(in.op) {
+            case irOp::load:
+            case irOp::store: {
+                affine f = formOf(in.a);
+                if(f.iv < 0 || f.m != in.size || f.base.isNone() || (size && size != in.size)) return fail();
+                size = in.size;
+                if(in.op == irOp::load) {
+                    vreg[in.dst] = nvec++;
+                    vop(kernel,irOp::vload,vreg[in.dst],address(f));
+                }else {
+                    int r = formOf(in.b).iv >= 0 ? -1 : lanesOf(in.b);
+                    if(r < 0) return fail();
+                    irInst st{irOp::vstore,-1,address(f),irVal::vec(r)};
+                    st.size = size;
+                    kernel.push_back(std::move(st));
+                }
+                accesses.push_back({f,in.op == irOp::store});
+                break;
+            }
+            case irOp::add:
+            case irOp::sub:
+            case irOp::mul:
+            case irOp::shl: {
+                if(formOf(in.a).iv >= 0 || formOf(in.b).iv >= 0) {
+                    forms[in.dst] = follow(in,formOf(in.a),formOf(in.b),l);
+                    if(forms[in.dst].iv < 0) return fail();
+                    break;
+                }
+                if(in.op != irOp::add && in.op != irOp::sub) return fail();
+                irVal x = in.a,y = in.b;
+                if(in.op == irOp::add && !isVec(x)) std::swap(x,y);
+                if(!isVec(x) && !isVec(y)) return fail();
+                int rx = lanesOf(x),ry = lanesOf(y);
+                if(rx < 0 || ry < 0) return fail();
+                // the left operand's register, unless something else still reads it
+                int r = rx;
+                if(!isVec(x) || uses[x.v] != 1) {
+                    r = nvec++;
+                    vop(kernel,irOp::vmov,r,irVal::vec(rx));
+                }
+                vop(kernel,in.op == irOp::add ? irOp::vadd : irOp::vsub,r,irVal::vec(ry));
+                vreg[in.dst] = r;
+                break;
+            }
+            case irOp::neg: {
+                if(!isVec(in.a)) return fail();
+                int r = nvec++;
+                vop(kernel,irOp::vsplat,r,irVal::imm(0));
+                vop(kernel,irOp::vsub,r,irVal::vec(vreg[in.a.v]));
+                vreg[in.dst] = r;
+                break;
+            }
+            default:
+                return fail();
+        }
+    }
+    bool stores = std::any_of(accesses.begin(),accesses.end(),[](const access& a) { return a.store; });
+    // %xmm15 is scratch in the backend
+    if((!stores && sums.empty()) || nvec > 15) return fail();
+    lanes = width / size;
+    std::vector<pair> checks;
+    for(size_t i = 0; i < accesses.size(); i++) {
+        for(size_t j = i + 1; j < accesses.size(); j++) {
+            if(!accesses[i].store && !accesses[j].store) continue;
+            if(!independent(accesses[i],accesses[j],checks)) return fail();
+        }
+    }
+
+    // arrays that may be one and the same are far enough apart, or exactly in step
+    irVal ok;
+    for(auto &c : checks) {
+        irVal x = emit(setup,irOp::add,c.x->f.base,irVal::imm(c.x->f.k));
+        irVal y = emit(setup,irOp::add,c.y->f.base,irVal::imm(c.y->f.k));
+        irVal d = emit(setup,irOp::sub,x,y);
+        irVal above = emit(setup,irOp::ge,d,irVal::imm(width));
+        irVal below = emit(setup,irOp::le,d,irVal::imm(-width));
+        irVal same = emit(setup,irOp::eq,d,irVal::imm(0));
+        irVal apart = emit(setup,irOp::add,emit(setup,irOp::add,above,below),same);
+        ok = ok.isNone() ? apart : emit(setup,irOp::mul,ok,apart);
+    }
+    // the limit below must not wrap, or the vector loop runs where the scalar one would not
+    int64_t lowest = INT64_MIN + (lanes - 1);
+    if(bound.isImm() && bound.v < lowest) return fail();
+    if(!bound.isImm()) {
+        irVal fits = emit(setup,irOp::ge,bound,irVal::imm(lowest));
+        ok = ok.isNone() ? fits : emit(setup,irOp::mul,ok,fits);
+    }
+    // a whole vector is left while the last of its lanes passes the test
+    irVal limit = emit(setup,irOp::sub,bound,irVal::imm(lanes - 1));
+
+    int n = blocks.size(),vh = n,vb = n + 1,vx = n + 2;
+    int next = func.newReg();
+    irBlock bh,bb,bx;
+    irInst phi{irOp::phi,vi};
+    phi.args = {init,irVal::reg(next)};
+    phi.incoming = {pre,vb};
+    bh.insts.push_back(std::move(phi));
+    irInst br{irOp::br,-1,irVal::reg(vi),limit};
+    br.cond = cc;
+    bh.insts.push_back(std::move(br));
+    bh.succs = {vb,vx};
+    bb.insts = std::move(kernel);
+    bb.insts.push_back({irOp::add,next,irVal::reg(vi),irVal::imm(lanes)});
+    bb.insts.push_back({irOp::jmp});
+    bb.succs = {vh};
+    std::vector<irVal> partial(sums.size());
+    for(size_t k = 0; k < sums.size(); k++) {
+        irInst total{irOp::vsum,func.newReg(),irVal::vec(sums[k].acc)};
+        total.size = 8;
+        bx.insts.push_back(total);
+        partial[k] = emit(bx.insts,irOp::add,sums[k].init,irVal::reg(total.dst));
+    }
+    bx.insts.push_back({irOp::jmp});
+    bx.succs = {h};
+
+    // the scalar loop carries on from where the vector loop stopped
+    for(auto &in : blocks[h].insts) {
+        if(in.op != irOp::phi) break;
+        irVal v = irVal::reg(vi);
+        for(size_t k = 0; k < sums.size(); k++) {
+            if(sums[k].phi == in.dst) v = partial[k];
+        }
+        if(ok.isNone()) {
+            size_t kp = std::find(in.incoming.begin(),in.incoming.end(),pre) - in.incoming.begin();
+            in.incoming[kp] = vx;
+            in.args[kp] = v;
+        }else {
+            in.args.push_back(v);
+            in.incoming.push_back(vx);
+        }
+    }
+    auto &p = blocks[pre];
+    p.insts.insert(p.insts.end() - 1,setup.begin(),setup.end());
+    if(ok.isNone()) {
+        p.succs = {vh};
+    }else {
+        p.insts.back() = irInst(irOp::br,-1,ok,irVal::imm(0));
+        p.succs = {vh,h};
+    }
+    blocks.push_back(std::move(bh));
+    blocks.push_back(std::move(bb));
+    blocks.push_back(std::move(bx));
+
+    std::vector<int> index(blocks.size());
+    for(int i = 0,k = 0; i < n; i++) {
+        if(i == h) {
+            index[vh] = k++;
+            index[vb] = k++;
+            index[vx] = k++;
+        }
+        index[i] = k++;
+    }
+    func.renumber(index);
+    func.vectorWidth = width;
+    done.push_back(iv);
+    done.push_back(vi);
+    return true;
+}
+
+
+void vectorizer::run() {
+    for(bool changed = true; changed;) {
+        changed = false;
+        loopinfo info(func,form);
+        info.analyze();
+        locate();
+        // the blocks move with every loop done, so the loops are found again
+        for(auto &l : info.loops()) {
+            if(vectorize(l)) {
+                changed = true;
+                break;
+            }
+        }
+    }
+}